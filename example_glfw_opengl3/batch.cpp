@@ -0,0 +1,162 @@
+#include "batch.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace cv;
+
+bool ReadManifest(const char* path, vector<BatchJob>& jobs, string& error)
+{
+    ifstream manifest(path);
+    if (!manifest.is_open()) {
+        error = string("Failed to open manifest ") + path;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+    while (getline(manifest, line)) {
+        line_number++;
+
+        //пропускаем пустые строки и комментарии
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') continue;
+
+        istringstream fields(line);
+        BatchJob job;
+        fields >> quoted(job.input) >> ws;
+        if (fields.peek() == '@') {
+            //углы и размер берутся из сохраненного профиля
+            fields.get();
+            fields >> quoted(job.profile);
+            if (job.profile.empty()) fields.setstate(ios::failbit);
+        }
+        else {
+            for (int i = 0; i < 4; i++) {
+                fields >> job.corners[i].x >> job.corners[i].y;
+            }
+        }
+        fields >> quoted(job.output);
+
+        if (fields.fail() || job.output.empty()) {
+            error = string(path) + ":" + to_string(line_number) + ": expected \"input x1 y1 x2 y2 x3 y3 x4 y4 output [encoder]\" or \"input @profile output [encoder]\"";
+            return false;
+        }
+
+        //кодировщик задания проверяем сразу, чтобы опечатка не всплыла посреди долгого пакета
+        SaveOptions encoding;
+        fields >> job.encoder;
+        if (!job.encoder.empty() && (!ParseSaveOptions(job.encoder, encoding) || !EncoderAvailable(encoding.format))) {
+            error = string(path) + ":" + to_string(line_number) + ": unknown or unavailable encoder " + job.encoder;
+            return false;
+        }
+        //иначе, например, байты PNG молча легли бы в out.jpg
+        SaveFormat extension_format;
+        if (!job.encoder.empty() && (!SaveFormatFromPath(job.output, extension_format) || extension_format != encoding.format)) {
+            error = string(path) + ":" + to_string(line_number) + ": encoder " + job.encoder + " does not match the extension of " + job.output;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+int RunBatch(const char* manifest, const PerspectiveSolver& solver, int threads, const string& profiles, const SaveOptions& encoding)
+{
+    vector<BatchJob> jobs;
+    string error;
+    if (!ReadManifest(manifest, jobs, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    //профили читаем только если манифест на них ссылается, неизвестное имя - ошибка манифеста
+    vector<HomographyProfile> known;
+    vector<const HomographyProfile*> job_profiles(jobs.size(), NULL);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].profile.empty()) continue;
+        if (known.empty() && !ReadProfiles(profiles, known, error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        job_profiles[i] = FindProfile(known, jobs[i].profile);
+        if (job_profiles[i] == NULL) {
+            cerr << manifest << ": unknown profile " << jobs[i].profile << endl;
+            return 1;
+        }
+    }
+    RemapCache tables(RemapCacheDirectory(profiles));
+
+    if (threads <= 0) threads = (int)thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    if (threads > (int)jobs.size()) threads = (int)jobs.size();
+
+    //параллелим по изображениям, поэтому внутренние потоки OpenCV только мешали бы друг другу
+    setNumThreads(1);
+
+    atomic<size_t> next_job(0);
+    atomic<int> failed(0);
+    mutex log_mutex;
+    size_t encoded_bytes = 0; //!<под log_mutex
+    double encode_seconds = 0; //!<суммарно по всем потокам, под log_mutex
+
+    auto started = chrono::steady_clock::now();
+
+    //пока потоки заняты текущими заданиями, ядро читает файлы следующих в кэш
+    size_t lookahead = (size_t)threads * 2;
+    for (size_t i = 0; i < lookahead && i < jobs.size(); i++) {
+        PrefetchFile(jobs[i].input);
+    }
+
+    auto worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            if (i + lookahead < jobs.size()) PrefetchFile(jobs[i + lookahead].input);
+            SolverStatus status;
+            Mat result;
+            if (job_profiles[i] != NULL) {
+                //таблица профиля считается или читается с диска один раз, остальные задания берут ее из памяти
+                shared_ptr<const RemapTable> table;
+                status = tables.Table(solver, *job_profiles[i], table);
+                if (status == SOLVER_OK) status = solver.Rectify(jobs[i].input, *table, result);
+            }
+            else status = solver.Rectify(jobs[i].input, jobs[i].corners, result);
+
+            //формат из описания задания или из расширения, незнакомые расширения остаются cv::imwrite
+            SaveOptions options = encoding;
+            EncodeStats stats;
+            bool known = SaveFormatFromPath(jobs[i].output, options.format);
+            if (!jobs[i].encoder.empty()) known = ParseSaveOptions(jobs[i].encoder, options);
+            if (status == SOLVER_OK) status = known ? SaveImage(jobs[i].output, result, options, stats) : solver.Save(jobs[i].output, result);
+
+            lock_guard<mutex> lock(log_mutex);
+            encoded_bytes += stats.bytes;
+            encode_seconds += stats.seconds;
+            if (status != SOLVER_OK) {
+                failed++;
+                cerr << jobs[i].input << ": " << SolverStatusText(status) << endl;
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (int i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    for (thread& t : pool) {
+        t.join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << jobs.size() - failed << "/" << jobs.size() << " images done in " << seconds << " s on " << threads << " threads, "
+        << encoded_bytes / 1024 << " KB encoded in " << encode_seconds << " s of encoder time" << endl;
+
+    return failed == 0 ? 0 : 2;
+}
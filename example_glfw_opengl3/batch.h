@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "solver.h"
+#include "profiles.h"
+#include "encoders.h"
+
+/*!
+Одно задание пакетной обработки: какое изображение исправить, по каким углам и куда сохранить результат
+*/
+struct BatchJob
+{
+    std::string input; //!<путь до исходного изображения
+    cv::Point2f corners[4]; //!<углы документа на исходном изображении, в любом порядке
+    std::string profile; //!<имя профиля вместо углов, пустое если углы заданы
+    std::string output; //!<путь, куда сохранить исправленное изображение
+    std::string encoder; //!<описание кодировщика для ParseSaveOptions, пустое - формат по расширению output
+};
+
+/*!
+Читает манифест пакетной обработки.
+Каждая непустая строка манифеста имеет вид "input x1 y1 x2 y2 x3 y3 x4 y4 output [encoder]" или "input @profile output [encoder]",
+пути и имена с пробелами берутся в кавычки, строки начинающиеся с # пропускаются.
+Необязательный encoder выбирает кодировщик задания, например "png:level=9" или "jpeg:quality=80,progressive".
+\param[in] path Путь до манифеста
+\param[out] jobs Прочитанные задания
+\param[out] error Описание ошибки, если манифест не прочитался
+\returns результат чтения манифеста
+*/
+bool ReadManifest(const char* path, std::vector<BatchJob>& jobs, std::string& error);
+
+/*!
+Исправляет перспективу всех изображений из манифеста без окна и без контекста OpenGL.
+Задания раздаются потокам пула по мере освобождения, каждое изображение целиком обрабатывается одним потоком,
+включая кодирование, поэтому задания с разными кодировщиками кодируются параллельно.
+\param[in] manifest Путь до манифеста
+\param[in] solver Движок с выбранными ядром и геометрией результата, общий для всех потоков
+\param[in] threads Количество рабочих потоков, 0 - по числу ядер
+\param[in] profiles Файл профилей для строк "@profile", таблицы профилей кэшируются рядом с ним
+\param[in] encoding Настройки кодирования по умолчанию, формат все равно берется из расширения или описания задания.
+Выходы с расширением, которого нет в SaveFormat, пишутся через cv::imwrite как раньше
+\returns код возврата процесса: 0 если все задания выполнены успешно
+*/
+int RunBatch(const char* manifest, const PerspectiveSolver& solver, int threads = 0, const std::string& profiles = PROFILES_FILE,
+    const SaveOptions& encoding = SaveOptions());
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/*!
+Блокирующая очередь ограниченной длины между стадиями конвейера.
+Push ждет, пока освободится место, Pop - пока появится элемент, поэтому быстрая стадия
+не накапливает в памяти больше capacity элементов, а ждет медленную.
+После Close новые элементы не принимаются, а Pop возвращает оставшиеся и затем false.
+*/
+template<typename T>
+class BoundedQueue
+{
+public:
+    /*!
+    \param[in] capacity Сколько элементов может ждать в очереди
+    */
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /*!
+    Кладет элемент в очередь, ждет если очередь заполнена
+    \param[in] item Элемент
+    \returns false если очередь уже закрыта
+    */
+    bool Push(T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+            if (closed) return false;
+            items.push_back(std::move(item));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    /*!
+    Забирает элемент из очереди, ждет если очередь пуста
+    \param[out] item Элемент
+    \returns false если очередь закрыта и пуста
+    */
+    bool Pop(T& item)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+            if (items.empty()) return false;
+            item = std::move(items.front());
+            items.pop_front();
+        }
+        not_full.notify_one();
+        return true;
+    }
+
+    /*!
+    Закрывает очередь и будит всех ждущих
+    */
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    /*!
+    Сколько элементов ждут в очереди
+    */
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    size_t capacity; //!<ограничение длины очереди
+    bool closed; //!<новые элементы не принимаются
+
+    std::mutex mutex;
+    std::condition_variable not_full; //!<будит Push, когда освободилось место
+    std::condition_variable not_empty; //!<будит Pop, когда появился элемент
+    std::deque<T> items;
+};
@@ -0,0 +1,346 @@
+#include "encoders.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+#ifdef SOLVER_HAVE_LIBJXL
+#include <jxl/encode.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+//IMWRITE_JPEG_SAMPLING_FACTOR появился в OpenCV 4.5.5, IMWRITE_JPEGXL_* - в 4.11
+#define SOLVER_CV_VERSION (CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION)
+#define SOLVER_CV_HAVE_JPEG_SAMPLING (SOLVER_CV_VERSION >= 40505)
+#define SOLVER_CV_HAVE_JPEGXL (SOLVER_CV_VERSION >= 41100)
+
+const char* SaveFormatExtension(SaveFormat format)
+{
+    switch (format) {
+    case SAVE_PNG: return ".png";
+    case SAVE_WEBP: return ".webp";
+    case SAVE_JXL: return ".jxl";
+    default: return ".jpg";
+    }
+}
+
+const char* SaveFormatMime(SaveFormat format)
+{
+    switch (format) {
+    case SAVE_PNG: return "image/png";
+    case SAVE_WEBP: return "image/webp";
+    case SAVE_JXL: return "image/jxl";
+    default: return "image/jpeg";
+    }
+}
+
+/*!
+Название формата или расширение без точки в нижнем регистре
+*/
+static bool ParseFormatName(string name, SaveFormat& format)
+{
+    transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+    if (name == "jpg" || name == "jpeg") format = SAVE_JPEG;
+    else if (name == "png") format = SAVE_PNG;
+    else if (name == "webp") format = SAVE_WEBP;
+    else if (name == "jxl") format = SAVE_JXL;
+    else return false;
+    return true;
+}
+
+bool SaveFormatFromPath(const string& path, SaveFormat& format)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == string::npos || path.find_first_of("/\\", dot) != string::npos) return false;
+    return ParseFormatName(path.substr(dot + 1), format);
+}
+
+bool JpegSubsamplingAvailable()
+{
+#if defined(SOLVER_HAVE_LIBJPEG_TURBO) || SOLVER_CV_HAVE_JPEG_SAMPLING
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ParseSaveOptions(const string& text, SaveOptions& options)
+{
+    size_t colon = text.find(':');
+    SaveOptions parsed = options;
+    if (!ParseFormatName(text.substr(0, colon), parsed.format)) return false;
+
+    stringstream keys(colon == string::npos ? string() : text.substr(colon + 1));
+    string key;
+    while (getline(keys, key, ',')) {
+        size_t equals = key.find('=');
+        string value = equals == string::npos ? string() : key.substr(equals + 1);
+        key = key.substr(0, equals);
+        int number = atoi(value.c_str());
+
+        if (parsed.format == SAVE_JPEG && key == "quality" && !value.empty()) parsed.jpeg_quality = min(max(number, 0), 100);
+        else if (parsed.format == SAVE_JPEG && key == "progressive") parsed.jpeg_progressive = value.empty() || number != 0;
+        else if (parsed.format == SAVE_JPEG && key == "subsampling") {
+            //без поддержки прореживания JPEG все равно выходит 4:2:0, другие значения молча не сработали бы
+            if (!JpegSubsamplingAvailable() && value != "420") return false;
+            if (value == "444") parsed.jpeg_subsampling = JPEG_SUBSAMPLING_444;
+            else if (value == "422") parsed.jpeg_subsampling = JPEG_SUBSAMPLING_422;
+            else if (value == "420") parsed.jpeg_subsampling = JPEG_SUBSAMPLING_420;
+            else return false;
+        }
+        else if (parsed.format == SAVE_PNG && key == "level" && !value.empty()) parsed.png_compression = min(max(number, 0), 9);
+        else if (parsed.format == SAVE_PNG && key == "strategy") {
+            const char* names[] = { "default", "filtered", "huffman", "rle", "fixed" };
+            auto found = find(begin(names), end(names), value);
+            if (found == end(names)) return false;
+            parsed.png_strategy = (PngStrategy)(found - begin(names));
+        }
+        else if (parsed.format == SAVE_WEBP && key == "quality" && !value.empty()) parsed.webp_quality = min(max(number, 1), 100);
+        else if (parsed.format == SAVE_WEBP && key == "lossless") parsed.webp_quality = 101;
+        else if (parsed.format == SAVE_JXL && key == "effort" && !value.empty()) parsed.jxl_effort = min(max(number, 1), 9);
+        else return false;
+    }
+    options = parsed;
+    return true;
+}
+
+vector<int> SaveParams(const SaveOptions& options)
+{
+    switch (options.format) {
+    case SAVE_PNG: return { IMWRITE_PNG_COMPRESSION, options.png_compression, IMWRITE_PNG_STRATEGY, options.png_strategy };
+    case SAVE_WEBP: return { IMWRITE_WEBP_QUALITY, options.webp_quality };
+#if SOLVER_CV_HAVE_JPEGXL
+    case SAVE_JXL: return { IMWRITE_JPEGXL_DISTANCE, 0, IMWRITE_JPEGXL_EFFORT, options.jxl_effort };
+#else
+    case SAVE_JXL: return {};
+#endif
+    default:
+        vector<int> params = { IMWRITE_JPEG_QUALITY, options.jpeg_quality, IMWRITE_JPEG_PROGRESSIVE, options.jpeg_progressive ? 1 : 0 };
+#if SOLVER_CV_HAVE_JPEG_SAMPLING
+        const int factors[] = { IMWRITE_JPEG_SAMPLING_FACTOR_444, IMWRITE_JPEG_SAMPLING_FACTOR_422, IMWRITE_JPEG_SAMPLING_FACTOR_420 };
+        params.push_back(IMWRITE_JPEG_SAMPLING_FACTOR);
+        params.push_back(factors[options.jpeg_subsampling]);
+#endif
+        return params;
+    }
+}
+
+bool EncoderAvailable(SaveFormat format)
+{
+    //наличие кодеков OpenCV не меняется во время работы, спрашиваем один раз
+    static const bool webp = haveImageWriter(".webp");
+#if defined(SOLVER_HAVE_LIBJXL)
+    static const bool jxl = true;
+#elif SOLVER_CV_HAVE_JPEGXL
+    static const bool jxl = haveImageWriter(".jxl");
+#else
+    static const bool jxl = false;
+#endif
+
+    switch (format) {
+    case SAVE_JPEG: return true;
+    case SAVE_PNG: return true;
+    case SAVE_WEBP: return webp;
+    case SAVE_JXL: return jxl;
+    default: return false;
+    }
+}
+
+const char* EncoderName(SaveFormat format)
+{
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+    if (format == SAVE_JPEG) return "libjpeg-turbo";
+#endif
+#ifdef SOLVER_HAVE_LIBJXL
+    if (format == SAVE_JXL) return "libjxl";
+#endif
+    return EncoderAvailable(format) ? "opencv" : "unavailable";
+}
+
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+
+/*!
+Ошибки libjpeg возвращаются через longjmp, иначе библиотека завершает процесс
+*/
+struct JpegError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr info)
+{
+    longjmp(((JpegError*)info->err)->jump, 1);
+}
+
+/*!
+Буфер jpeg_mem_dest, живет в памяти, а не в регистрах, поэтому переживает longjmp
+*/
+struct JpegOutput
+{
+    unsigned char* data = NULL;
+    unsigned long size = 0;
+};
+
+/*!
+Кодирует JPEG напрямую через libjpeg-turbo: строки BGR читаются из изображения без cvtColor
+*/
+static SolverStatus EncodeJpegTurbo(const Mat& image, const SaveOptions& options, vector<uchar>& bytes)
+{
+    jpeg_compress_struct info;
+    JpegError error;
+    JpegOutput output;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = JpegErrorExit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&info);
+        free(output.data);
+        return SOLVER_SAVE_FAILED;
+    }
+
+    jpeg_create_compress(&info);
+    jpeg_mem_dest(&info, &output.data, &output.size);
+    info.image_width = image.cols;
+    info.image_height = image.rows;
+    info.input_components = image.channels();
+    info.in_color_space = image.channels() == 1 ? JCS_GRAYSCALE : image.channels() == 4 ? JCS_EXT_BGRA : JCS_EXT_BGR;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, options.jpeg_quality, TRUE);
+
+    //прореживание задается частотой яркости, у цветовых компонент частота 1
+    if (image.channels() > 1) {
+        info.comp_info[0].h_samp_factor = options.jpeg_subsampling == JPEG_SUBSAMPLING_444 ? 1 : 2;
+        info.comp_info[0].v_samp_factor = options.jpeg_subsampling == JPEG_SUBSAMPLING_420 ? 2 : 1;
+    }
+    if (options.jpeg_progressive) jpeg_simple_progression(&info);
+
+    jpeg_start_compress(&info, TRUE);
+    while (info.next_scanline < info.image_height) {
+        JSAMPROW row = (JSAMPROW)image.ptr((int)info.next_scanline);
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    bytes.assign(output.data, output.data + output.size);
+    free(output.data);
+    return SOLVER_OK;
+}
+
+#endif
+
+#ifdef SOLVER_HAVE_LIBJXL
+
+/*!
+Кодирует JPEG XL без потерь через libjxl в одном потоке: параллельность дает очередь заданий
+*/
+static SolverStatus EncodeJxl(const Mat& image, const SaveOptions& options, vector<uchar>& bytes)
+{
+    //libjxl принимает только плотные строки в порядке RGB
+    Mat rgb;
+    if (image.channels() == 1) rgb = image.isContinuous() ? image : image.clone();
+    else cvtColor(image, rgb, image.channels() == 4 ? COLOR_BGRA2RGBA : COLOR_BGR2RGB);
+
+    JxlEncoder* encoder = JxlEncoderCreate(NULL);
+    if (encoder == NULL) return SOLVER_SAVE_FAILED;
+
+    JxlBasicInfo info;
+    JxlEncoderInitBasicInfo(&info);
+    info.xsize = rgb.cols;
+    info.ysize = rgb.rows;
+    info.bits_per_sample = 8;
+    info.num_color_channels = rgb.channels() == 1 ? 1 : 3;
+    info.num_extra_channels = rgb.channels() == 4 ? 1 : 0;
+    info.alpha_bits = rgb.channels() == 4 ? 8 : 0;
+    info.uses_original_profile = JXL_TRUE;
+
+    JxlColorEncoding color;
+    JxlColorEncodingSetToSRGB(&color, rgb.channels() == 1 ? JXL_TRUE : JXL_FALSE);
+
+    JxlPixelFormat format = { (uint32_t)rgb.channels(), JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+    JxlEncoderFrameSettings* settings = NULL;
+    bool ok = JxlEncoderSetBasicInfo(encoder, &info) == JXL_ENC_SUCCESS
+        && JxlEncoderSetColorEncoding(encoder, &color) == JXL_ENC_SUCCESS
+        && (settings = JxlEncoderFrameSettingsCreate(encoder, NULL)) != NULL
+        && JxlEncoderSetFrameLossless(settings, JXL_TRUE) == JXL_ENC_SUCCESS
+        && JxlEncoderFrameSettingsSetOption(settings, JXL_ENC_FRAME_SETTING_EFFORT, options.jxl_effort) == JXL_ENC_SUCCESS
+        && JxlEncoderAddImageFrame(settings, &format, rgb.ptr(), rgb.total() * rgb.elemSize()) == JXL_ENC_SUCCESS;
+    if (ok) JxlEncoderCloseInput(encoder);
+
+    //размер результата заранее неизвестен, буфер растет вдвое, пока кодировщик просит еще
+    bytes.resize(ok ? max((size_t)4096, rgb.total() * rgb.elemSize() / 4) : 0);
+    size_t written = 0;
+    JxlEncoderStatus status = JXL_ENC_NEED_MORE_OUTPUT;
+    while (ok && status == JXL_ENC_NEED_MORE_OUTPUT) {
+        uint8_t* next = bytes.data() + written;
+        size_t available = bytes.size() - written;
+        status = JxlEncoderProcessOutput(encoder, &next, &available);
+        written = next - bytes.data();
+        if (status == JXL_ENC_NEED_MORE_OUTPUT) bytes.resize(bytes.size() * 2);
+    }
+    JxlEncoderDestroy(encoder);
+
+    if (!ok || status != JXL_ENC_SUCCESS) {
+        bytes.clear();
+        return SOLVER_SAVE_FAILED;
+    }
+    bytes.resize(written);
+    return SOLVER_OK;
+}
+
+#endif
+
+SolverStatus EncodeImage(const Mat& image, const SaveOptions& options, vector<uchar>& bytes)
+{
+    SOLVER_PROFILE_SCOPE("encode");
+    if (image.empty()) return SOLVER_EMPTY_RESULT;
+    if (image.depth() != CV_8U || !EncoderAvailable(options.format)) return SOLVER_SAVE_FAILED;
+
+    try
+    {
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+        if (options.format == SAVE_JPEG) return EncodeJpegTurbo(image, options, bytes);
+#endif
+#ifdef SOLVER_HAVE_LIBJXL
+        if (options.format == SAVE_JXL) return EncodeJxl(image, options, bytes);
+#endif
+        if (!imencode(SaveFormatExtension(options.format), image, bytes, SaveParams(options))) return SOLVER_SAVE_FAILED;
+    }
+    catch (const std::exception&)
+    {
+        return SOLVER_SAVE_FAILED;
+    }
+    return SOLVER_OK;
+}
+
+SolverStatus SaveImage(const string& path, const Mat& image, const SaveOptions& options, EncodeStats& stats)
+{
+    vector<uchar> bytes;
+    auto started = chrono::steady_clock::now();
+    SolverStatus status = EncodeImage(image, options, bytes);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    stats.bytes = bytes.size();
+    if (status != SOLVER_OK) return status;
+
+    SOLVER_PROFILE_SCOPE("write");
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) return SOLVER_SAVE_FAILED;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) remove(path.c_str());
+    return ok ? SOLVER_OK : SOLVER_SAVE_FAILED;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "solver.h"
+
+/*!
+Формат сохраняемого изображения
+*/
+enum SaveFormat
+{
+    SAVE_JPEG = 0,
+    SAVE_PNG,
+    SAVE_WEBP,
+    SAVE_JXL, //!<JPEG XL без потерь, есть только с libjxl или OpenCV 4.11+
+    SAVE_FORMAT_COUNT
+};
+
+/*!
+Прореживание цвета JPEG
+*/
+enum JpegSubsampling
+{
+    JPEG_SUBSAMPLING_444 = 0, //!<без прореживания
+    JPEG_SUBSAMPLING_422, //!<цвет вдвое реже по горизонтали
+    JPEG_SUBSAMPLING_420 //!<цвет вдвое реже по обеим осям, как у imwrite по умолчанию
+};
+
+/*!
+Стратегия сжатия zlib для PNG, значения совпадают с cv::IMWRITE_PNG_STRATEGY_*
+*/
+enum PngStrategy
+{
+    PNG_STRATEGY_DEFAULT = 0, //!<обычное сжатие
+    PNG_STRATEGY_FILTERED, //!<для изображений после фильтров строк, обычно лучше на фотографиях
+    PNG_STRATEGY_HUFFMAN_ONLY, //!<без поиска повторов, самое быстрое
+    PNG_STRATEGY_RLE, //!<повторы только соседних байт, быстро на сканах с большими одноцветными полями
+    PNG_STRATEGY_FIXED //!<без собственных таблиц Хаффмана
+};
+
+/*!
+Настройки кодирования при сохранении
+*/
+struct SaveOptions
+{
+    SaveFormat format = SAVE_JPEG; //!<формат файла
+    int jpeg_quality = 95; //!<качество JPEG, 0..100
+    JpegSubsampling jpeg_subsampling = JPEG_SUBSAMPLING_420; //!<прореживание цвета JPEG
+    bool jpeg_progressive = false; //!<прогрессивный JPEG: меньше файл, дольше кодирование
+    int png_compression = 3; //!<степень сжатия PNG, 0..9
+    PngStrategy png_strategy = PNG_STRATEGY_DEFAULT; //!<стратегия zlib для PNG
+    int webp_quality = 90; //!<качество WebP, 1..100, больше 100 - без потерь
+    int jxl_effort = 7; //!<усилие JPEG XL, 1..9: больше - меньше файл и дольше кодирование
+};
+
+/*!
+Расширение файла для формата, вместе с точкой
+*/
+const char* SaveFormatExtension(SaveFormat format);
+
+/*!
+MIME-тип формата для ответов сервиса
+*/
+const char* SaveFormatMime(SaveFormat format);
+
+/*!
+Определяет формат по расширению пути: .jpg, .jpeg, .png, .webp или .jxl без учета регистра
+\param[in] path Путь до файла
+\param[out] format Формат
+\returns известно ли расширение
+*/
+bool SaveFormatFromPath(const std::string& path, SaveFormat& format);
+
+/*!
+Можно ли выбрать прореживание цвета JPEG: нужна libjpeg-turbo (SOLVER_HAVE_LIBJPEG_TURBO) или OpenCV 4.5.5+,
+иначе JPEG всегда кодируется с 4:2:0
+*/
+bool JpegSubsamplingAvailable();
+
+/*!
+Разбирает описание кодировщика вида "формат[:ключ=значение,...]", например "jpeg:quality=90,subsampling=444,progressive",
+"png:level=9,strategy=rle", "webp:lossless" или "jxl:effort=3". Ключи, которых нет в описании, остаются как были.
+Ключи JPEG: quality, subsampling (444, 422, 420), progressive. PNG: level, strategy (default, filtered, huffman, rle, fixed).
+WebP: quality, lossless. JPEG XL: effort.
+\param[in] text Описание
+\param[in,out] options Настройки, формат и указанные ключи заменяются
+\returns false если формат или ключ неизвестны, а также для subsampling=444 и 422, если JpegSubsamplingAvailable() ложно
+*/
+bool ParseSaveOptions(const std::string& text, SaveOptions& options);
+
+/*!
+Параметры cv::imwrite для настроек кодирования
+*/
+std::vector<int> SaveParams(const SaveOptions& options);
+
+/*!
+Может ли сборка кодировать в этот формат
+*/
+bool EncoderAvailable(SaveFormat format);
+
+/*!
+Чем кодируется формат в этой сборке, например "libjpeg-turbo" или "opencv"
+*/
+const char* EncoderName(SaveFormat format);
+
+/*!
+Кодирует изображение в память выбранным кодировщиком.
+JPEG кодируется прямо через libjpeg-turbo, если сборка с SOLVER_HAVE_LIBJPEG_TURBO, JPEG XL - через libjxl с SOLVER_HAVE_LIBJXL,
+остальное через cv::imencode. Функция не хранит состояния и вызывается из любого числа потоков одновременно.
+\param[in] image Изображение CV_8UC1, CV_8UC3 или CV_8UC4 в порядке BGR
+\param[in] options Формат и его настройки
+\param[out] bytes Закодированный файл
+\returns SOLVER_OK, SOLVER_EMPTY_RESULT или SOLVER_SAVE_FAILED, в том числе если формат недоступен
+*/
+SolverStatus EncodeImage(const cv::Mat& image, const SaveOptions& options, std::vector<uchar>& bytes);
+
+/*!
+Итог кодирования одного изображения
+*/
+struct EncodeStats
+{
+    size_t bytes = 0; //!<размер закодированного файла
+    double seconds = 0; //!<сколько заняло только кодирование, без записи на диск
+};
+
+/*!
+Кодирует изображение и записывает на диск одним вызовом fwrite
+\param[in] path Куда сохранить
+\param[in] image Изображение
+\param[in] options Формат и его настройки, расширение пути не проверяется
+\param[out] stats Размер и время кодирования
+\returns результат сохранения
+*/
+SolverStatus SaveImage(const std::string& path, const cv::Mat& image, const SaveOptions& options, EncodeStats& stats);
@@ -0,0 +1,126 @@
+#include "gl_texture.h"
+#include "profiler.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <iostream>
+
+using namespace cv;
+
+void ConvertToBGRA(const Mat& image, Mat& bgra)
+{
+    switch (image.channels()) {
+    case 1: cvtColor(image, bgra, COLOR_GRAY2BGRA); break;
+    case 3: cvtColor(image, bgra, COLOR_BGR2BGRA); break;
+    default: image.copyTo(bgra); break;
+    }
+}
+
+GLTexture::GLTexture() : texture(0), width(0), height(0), pbo_index(0)
+{
+    for (int i = 0; i < PBO_COUNT; i++) pbo[i] = 0;
+}
+
+GLTexture::~GLTexture()
+{
+    Release();
+}
+
+void GLTexture::Release()
+{
+    if (texture != 0) glDeleteTextures(1, &texture);
+    if (pbo[0] != 0) glDeleteBuffers(PBO_COUNT, pbo);
+
+    texture = 0;
+    width = height = 0;
+    for (int i = 0; i < PBO_COUNT; i++) pbo[i] = 0;
+    staging.release();
+}
+
+void GLTexture::Allocate(int new_width, int new_height)
+{
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        //Set texture clamping method
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    //хранилище пересоздается только при смене размера
+    if (new_width != width || new_height != height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, new_width, new_height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+        width = new_width;
+        height = new_height;
+    }
+}
+
+void GLTexture::Update(const Mat& image)
+{
+    SOLVER_PROFILE_SCOPE("texture_upload");
+    if (image.empty() || image.depth() != CV_8U) {
+        std::cout << "image empty" << std::endl;
+        return;
+    }
+
+    Allocate(image.cols, image.rows);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    if ((size_t)image.cols * image.rows * 4 >= STREAM_THRESHOLD) UploadStreamed(image);
+    else UploadDirect(image);
+}
+
+void GLTexture::UploadDirect(const Mat& image)
+{
+    const Mat* source = &image;
+    if (image.channels() != 4 || !image.isContinuous()) {
+        staging.create(image.rows, image.cols, CV_8UC4);
+        ConvertToBGRA(image, staging);
+        source = &staging;
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows, GL_BGRA, GL_UNSIGNED_BYTE, source->ptr());
+}
+
+void GLTexture::UploadStreamed(const Mat& image)
+{
+    size_t size = (size_t)image.cols * image.rows * 4;
+
+    if (pbo[0] == 0) glGenBuffers(PBO_COUNT, pbo);
+
+    //следующий буфер кольца: предыдущий, возможно, еще копируется драйвером в текстуру
+    pbo_index = (pbo_index + 1) % PBO_COUNT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[pbo_index]);
+
+    //новое хранилище под тот же буфер, чтобы не ждать, пока драйвер дочитает старое
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != NULL) {
+        //преобразование в BGRA сразу в память буфера, без промежуточной копии
+        Mat target(image.rows, image.cols, CV_8UC4, mapped);
+        ConvertToBGRA(image, target);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        //при привязанном буфере последний аргумент - смещение в нем
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.cols, image.rows, GL_BGRA, GL_UNSIGNED_BYTE, (const void*)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        UploadDirect(image);
+    }
+}
+
+void BindCVMat2GLTexture(const Mat& image, GLTexture& imageTexture)
+{
+    imageTexture.Update(image);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+// About Desktop OpenGL function loaders: see main.cpp, the same loader must be selected here.
+#if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
+#include <GL/gl3w.h>
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLEW)
+#include <GL/glew.h>
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
+#include <glad/glad.h>
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLBINDING)
+#define GLFW_INCLUDE_NONE
+#include <glbinding/glbinding.h>
+#include <glbinding/gl/gl.h>
+using namespace gl;
+#else
+#include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
+#endif
+
+/*!
+Текстура OpenGL для показа матриц OpenCV.
+Хранилище создается один раз и переиспользуется, пока не изменится размер, обновление идет через glTexSubImage2D.
+Пиксели всегда хранятся как 4-байтные BGRA, поэтому строки выровнены и драйвер не переставляет байты по одному.
+Большие изображения передаются через кольцо pixel buffer object: преобразование в BGRA пишется прямо
+в отображенный буфер, а копирование в текстуру драйвер выполняет асинхронно, пока готовится следующий кадр.
+Все методы надо вызывать из потока, где текущий контекст OpenGL.
+*/
+class GLTexture
+{
+public:
+    GLTexture();
+    ~GLTexture();
+
+    GLTexture(const GLTexture&) = delete;
+    GLTexture& operator=(const GLTexture&) = delete;
+
+    /*!
+    Загружает матрицу в текстуру
+    \param[in] image 8-битная матрица OpenCV: BGR, BGRA или серая. Непрерывная BGRA меньше порога PBO
+    передается драйверу как есть, поэтому ее выгодно получать сразу из исправления (WARP_LAYOUT_BGRA)
+    */
+    void Update(const cv::Mat& image);
+
+    /*!
+    Удаляет текстуру и буферы, должен быть вызван до уничтожения контекста OpenGL
+    */
+    void Release();
+
+    GLuint Id() const { return texture; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    static const int PBO_COUNT = 3; //!<размер кольца буферов
+    static const size_t STREAM_THRESHOLD = 1 << 22; //!<с какого размера в байтах загружать через буферы
+
+private:
+    void Allocate(int new_width, int new_height);
+    void UploadDirect(const cv::Mat& image);
+    void UploadStreamed(const cv::Mat& image);
+
+    GLuint texture; //!<идентификатор текстуры
+    int width; //!<ширина хранилища текстуры
+    int height; //!<высота хранилища текстуры
+
+    GLuint pbo[PBO_COUNT]; //!<кольцо pixel buffer object
+    int pbo_index; //!<буфер, в который шла последняя загрузка
+
+    cv::Mat staging; //!<переиспользуемый BGRA буфер для загрузки без PBO, непрерывная BGRA его не выделяет
+};
+
+/*!
+Переводит матрицу в BGRA, записывая результат в уже выделенный буфер
+\param[in] image BGR, BGRA или серая матрица
+\param[out] bgra Буфер размера image с 4 каналами
+*/
+void ConvertToBGRA(const cv::Mat& image, cv::Mat& bgra);
+
+/*!
+Привязывает матрицу OpenCV к текстуре OpenGL
+\param[in] image матрица OpenCV, которую надо загрузить в текстуру
+\param[out] imageTexture Текстура, куда будет загружена матрица OpenCV
+*/
+void BindCVMat2GLTexture(const cv::Mat& image, GLTexture& imageTexture);
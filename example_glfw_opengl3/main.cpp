@@ -11,6 +11,16 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "solver.h"
+#include "profiles.h"
+#include "batch.h"
+#include "stream.h"
+#include "watch.h"
+#include "server.h"
+#include "profiler.h"
+#include "preview.h"
+#include "save_queue.h"
+#include "tiled_view.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
@@ -39,6 +49,10 @@ using namespace gl;
 
 // Include glfw3.h after our OpenGL definitions
 #include <GLFW/glfw3.h>
+#include "gl_texture.h"
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
 
 using namespace std;
@@ -55,230 +69,227 @@ static void glfw_error_callback(int error, const char* description)
     fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+const int REDRAW_BURST = 5; //!<сколько кадров рисовать после события, чтобы ImGui успел закончить раскладку и анимации
+const double IDLE_TIMEOUT = 0.25; //!<как часто просыпаться без событий, пока курсор над элементом: подсказке нужен кадр после задержки
 
-// Simple helper function to load an image into a OpenGL texture with common settings
+static atomic<int> redraw_frames(REDRAW_BURST); //!<сколько кадров еще нарисовать, прежде чем ждать событий; просят и фоновые потоки
 
 /*!
-    OpenGL
-\param[in] filename   
-\param[out] out_texture ,    
-\param[out] out_width   
-\param[out] out_height  
-\returns   
+Просит нарисовать еще несколько кадров: что-то изменилось на экране
 */
-bool LoadTextureFromFile(const char* filename, GLuint* out_texture, int* out_width, int* out_height)
+static void RequestRedraw()
 {
-    glDeleteTextures(1, out_texture);
-
-    // Load from file
-    int image_width = 0;
-    int image_height = 0;
-    unsigned char* image_data = stbi_load(filename, &image_width, &image_height, NULL, 4);
-    if (image_data == NULL)
-        return false;
-
-    // Create a OpenGL texture identifier
-    GLuint image_texture;
-    glGenTextures(1, &image_texture);
-    glBindTexture(GL_TEXTURE_2D, image_texture);
-
-    // Setup filtering parameters for display
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Upload pixels into texture
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    stbi_image_free(image_data);
-
-    *out_texture = image_texture;
-    *out_width = image_width;
-    *out_height = image_height;
-
-    return true;
+    redraw_frames = REDRAW_BURST;
 }
 
-/*!
-  OpenCV   OpenGL
-\param[in] Mat  OpenCV,     
-\param[out] out_texture ,     OpenCV
-*/
-void BindCVMat2GLTexture(const Mat& image, GLuint& imageTexture)
-{
-    if (image.empty()) {
-        std::cout << "image empty" << std::endl;
-    }
-    else {
-        glDeleteTextures(1, &imageTexture);
-
-        glEnable(GL_TEXTURE_2D); 
-
-        glGenTextures(1, &imageTexture);
-        glBindTexture(GL_TEXTURE_2D, imageTexture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        //Set texture clamping method
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        glTexImage2D(GL_TEXTURE_2D, // Type of texture
-            0, // Pyramid level (for mip-mapping) - 0 is the top level
-            GL_RGB, // Internal colour format to convert to
-            image.cols, // Image width i.e. 640 for Kinect in standard mode
-            image.rows, // Image height i.e. 480 for Kinect in standard mode
-            0, // Border width in pixels (can either be 1 or 0)
-            GL_BGR, // Input image format (i.e. GL_RGB, GL_RGBA, GL_BGR etc.)
-            GL_UNSIGNED_BYTE, // Image data type
-            image.ptr()); // The actual image data itself
-            //NULL);
-    }
-}
+//обработчики GLFW только поднимают флаг перерисовки, ImGui получает те же события по цепочке
+static void redraw_mouse_button_callback(GLFWwindow*, int, int, int) { RequestRedraw(); }
+static void redraw_scroll_callback(GLFWwindow*, double, double) { RequestRedraw(); }
+static void redraw_key_callback(GLFWwindow*, int, int, int, int) { RequestRedraw(); }
+static void redraw_char_callback(GLFWwindow*, unsigned int) { RequestRedraw(); }
+static void redraw_cursor_callback(GLFWwindow*, double, double) { RequestRedraw(); }
+static void redraw_window_callback(GLFWwindow*) { RequestRedraw(); }
+static void redraw_focus_callback(GLFWwindow*, int) { RequestRedraw(); }
+static void redraw_size_callback(GLFWwindow*, int, int) { RequestRedraw(); }
 
 /*!
-    
-\param[in] text   
-\param[out] error   
-\returns   
+Меняет размер окна, только если он отличается: оконный менеджер перерисовывает окно на каждый запрос
 */
-bool OK(const char* text, char*& error)//    
+static void ResizeWindow(GLFWwindow* window, int width, int height)
 {
-
-    Mat test_read = imread(text);
-    std::string str(text);
-
-    if (str.empty()) {
-        error = "Empty path to image";
-        return false;
-    }
-    else if(test_read.empty()){
-        error = "Empty image. Failed to open.";
-        return false;
-    }
-    else {
-        error = "Ok";
-        return true;
-    }
+    int current_width, current_height;
+    glfwGetWindowSize(window, &current_width, &current_height);
+    if (current_width != width || current_height != height) glfwSetWindowSize(window, width, height);
 }
 
+
 /*!
- ,       OpenCV( ,  ,  ,  )
-\param points  
+Рисует поверх изображения отмеченные углы и соединяющие их линии, само изображение и его текстура не меняются
+\param[in] draw_list Список отрисовки окна
+\param[in] origin Положение левого верхнего угла изображения на экране
+\param[in] points Отмеченные точки в координатах изображения
+\param[in] count Сколько точек отмечено
+\param[in] koef коэфициент масштабирования изображения для удобного отображения
+\param[in] sorted Точки уже отсортированы SortPoints, рисуем замкнутый четырехугольник
 */
-void SortPoints(Point2f points[])//  ,  ,   opencv
+void DrawCorners(ImDrawList* draw_list, ImVec2 origin, const Point2f points[], int count, float koef, bool sorted)
 {
-
-    Point2f tmp(0,0);
-    for (int i = 0; i < 4; i++) {
-        for (int j = 3; j >= (i + 1); j--) {
-            if (points[j].y < points[j - 1].y) {
-                tmp = points[j];
-                points[j] = points[j - 1];
-                points[j - 1] = tmp;
-            }
-        }
-    }
-   
-    if (points[0].x > points[1].x) {
-        tmp = points[1];
-        points[1] = points[0];
-        points[0] = tmp;
+    //SortPoints хранит углы как левый верхний, правый верхний, левый нижний, правый нижний, а контур обходим по кругу
+    static const int contour[4] = { 0, 1, 3, 2 };
+    const ImU32 color = IM_COL32(0, 0, 255, 255);
+
+    ImVec2 screen[4];
+    for (int i = 0; i < count; i++) {
+        const Point2f& p = points[sorted ? contour[i] : i];
+        screen[i] = ImVec2(origin.x + p.x / koef, origin.y + p.y / koef);
     }
 
-    if (points[2].x > points[3].x) {
-        tmp = points[3];
-        points[3] = points[2];
-        points[2] = tmp;
+    if (count > 1) draw_list->AddPolyline(screen, count, color, sorted, 2.0f);
+    for (int i = 0; i < count; i++) {
+        draw_list->AddCircleFilled(screen[i], 5, color);
     }
-
-
-}
-
-/*!
-  
-\param[in] x1 -  
-\param[in] y1 Y-  
-\param[in] x2 -  
-\param[in] y2 Y-  
-\returns  
-*/
-float VectorLenght(int x1, int y1, int x2, int y2)// 
-{
-    return(sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)));
-
 }
 
 /*!
-    
-\param points  
-\returns    
+Ищет отмеченный угол под курсором
+\param[in] mouse Положение курсора на экране
+\param[in] origin Положение левого верхнего угла изображения на экране
+\param[in] points Углы в координатах изображения
+\param[in] koef коэфициент масштабирования изображения для удобного отображения
+\param[in] radius На каком расстоянии в пикселях экрана угол можно схватить
+\returns номер угла или -1, если курсор не над углом
 */
-float CalcPicSize(Point2f points[]) //   
+int HitCorner(ImVec2 mouse, ImVec2 origin, const Point2f points[], float koef, float radius)
 {
-    int len = 0;
-    int minLen = VectorLenght(points[3].x, points[3].y, points[0].x, points[0].y);
-    for (size_t i = 0; i < 3; i++)
-    {
-        len = VectorLenght(points[i].x, points[i].y, points[i + 1].x, points[i + 1].y);
-        if (len <= minLen) minLen = len; 
+    for (int i = 0; i < 4; i++) {
+        float dx = origin.x + points[i].x / koef - mouse.x;
+        float dy = origin.y + points[i].y / koef - mouse.y;
+        if (dx * dx + dy * dy <= radius * radius) return i;
     }
-    return minLen;
+    return -1;
 }
 
-
 /*!
-  . 
-\param[in] text ,   
-\param[in] result  
-\param[in] save_counter   ,   
-\param[in] name      
+Ставит исправенное изображение в очередь на сохранение. 
+\param[in] queue Очередь фонового сохранения
+\param[in] text Путь, куда надо сохранять
+\param[in] result Исправленная картинка
+\param[in] options Формат и качество сохранения
+\param[in] save_counter порядковый номер картинки, которую будем сохранять
+\param[in] name Имя под которым надо сохранить картинку
+\returns принято ли изображение в очередь
 */
-void Save(const char* text, Mat result, int& save_counter, string name = "SolvedImage") {
-    string saveTo(text);//  char  string
-    string saveTo1 = saveTo+"/" + name + std::to_string(save_counter) + ".jpg"; //     
+SolverStatus Save(SaveQueue& queue, const char* text, const Mat& result, const SaveOptions& options, int& save_counter, string name = "SolvedImage") {
+    string saveTo(text);//преобразуе из char в string
+    string saveTo1 = saveTo+"/" + name + std::to_string(save_counter) + SaveFormatExtension(options.format); //формируем название файла и путь сохранения
     std::cout << saveTo1;
-    save_counter++;
-    try
-    {
-       imwrite(saveTo1, result); //
-    }
-    catch (const std::exception&)
-    {
-        ImGui::OpenPopup("saveError");
-    }
+    SolverStatus status = queue.Push(saveTo1, result, options); //сохраняем в фоне
+    if (status == SOLVER_OK) save_counter++;
+    return status;
 }
 
 /*!
-  ,       
-\param[in] left    
-\param[in] right   
-\param[in] koef      
-\returns  
+Считает высоту окна, которая должна быть в данный момент 
+\param[in] left высота левой текстуры 
+\param[in] right высота правой текстуры
+\param[in] koef коэфициент масштабирования изображения для удобного отображения
+\returns Высоту окна
 */
 float height(int& left, int& right, float& koef) {
     if (left/koef > right/koef) return ((float)left) / koef;
     else return right/koef; 
 }
-int my_image_width = 0;//!<   
-int my_image_height = 0;//!<   
-GLuint my_image_texture = 0;//!<   ( )
+int my_image_width = 0;//!< Ширина левой картинки
+int my_image_height = 0;//!< Высота правой картинки
 
-int my2_image_width = 0;//!<   
-int my2_image_height = 0;//!<   
-GLuint my2_image_texture;//!<   ( )
+int my2_image_width = 0;//!< Ширина правой картинки
+int my2_image_height = 0;//!< Высота правой картинки
+GLTexture my2_image_texture;//!< Текстура правой картинки(обработанного изображения)
 
-char* error1 = new char[16];//!<    
-static char buf1[64] = "";//!<  
-int main(int, char**)
+const char* error1 = "";//!<указатель на сообщение об ошибке
+static char buf1[64] = "";//!<путь до изображения
+int main(int argc, char** argv)
 {
+    //режимы без окна:
+    //perspective_solver --batch manifest.txt [ключи]
+    //perspective_solver --stream input output x1 y1 x2 y2 x3 y3 x4 y4 [ключи]
+    //perspective_solver --watch input_dir output_dir [ключи]
+    //perspective_solver --serve port|unix:path [ключи]
+    //ключи: [--threads N] [--simd] [--size WxH|quad|a4|letter] [--dpi N] [--depth N] [--trace trace.json] [--profiles profiles.txt]
+    //[--gray] [--encode jpeg:quality=90,subsampling=444,progressive]
+    if (argc >= 2 && (string(argv[1]) == "--batch" || string(argv[1]) == "--stream" || string(argv[1]) == "--watch" || string(argv[1]) == "--serve")) {
+        bool stream = string(argv[1]) == "--stream";
+        bool watch = string(argv[1]) == "--watch";
+        bool serve = string(argv[1]) == "--serve";
+        int first = stream ? 12 : watch ? 4 : 3; //!<с какого аргумента начинаются ключи
+        const char* usage = "Usage: %s --batch <manifest> [options]\n"
+            "       %s --stream <input> <output> x1 y1 x2 y2 x3 y3 x4 y4 [options]\n"
+            "       %s --watch <input_dir> <output_dir> [options]\n"
+            "       %s --serve <port|unix:path> [options]\n"
+            "Options: [--threads N] [--simd] [--size WxH|quad|a4|letter] [--dpi N] [--depth N] [--trace trace.json]\n"
+            "         [--profiles profiles.txt] [--gray] [--encode format[:key=value,...]]\n";
+        if (argc < first) {
+            fprintf(stderr, usage, argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        int threads = 0;
+        int depth = 4;
+        string trace; //!<куда записать трассировку стадий по окончании
+        string profiles = PROFILES_FILE; //!<откуда брать профили для строк манифеста "@profile"
+        WarpBackend backend = WARP_OPENCV;
+        WarpLayout layout = WARP_LAYOUT_SOURCE; //!<--gray сохраняет серые документы, перевод идет в том же проходе, что и исправление
+        OutputGeometry geometry;
+        SaveOptions encoding; //!<настройки кодировщиков пакета, формат задания все равно по расширению
+        bool encoding_given = false;
+        for (int i = first; i < argc; i++) {
+            if (string(argv[i]) == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (string(argv[i]) == "--depth" && i + 1 < argc) depth = atoi(argv[++i]);
+            else if (string(argv[i]) == "--simd") backend = WARP_SIMD;
+            else if (string(argv[i]) == "--gray") layout = WARP_LAYOUT_GRAY;
+            else if (string(argv[i]) == "--dpi" && i + 1 < argc) geometry.dpi = min(max(atoi(argv[++i]), 0), MAX_DPI);
+            else if (string(argv[i]) == "--trace" && i + 1 < argc) trace = argv[++i];
+            else if (string(argv[i]) == "--profiles" && i + 1 < argc) profiles = argv[++i];
+            else if (string(argv[i]) == "--encode" && i + 1 < argc) {
+                encoding_given = true;
+                if (!ParseSaveOptions(argv[++i], encoding) || !EncoderAvailable(encoding.format)) {
+                    fprintf(stderr, "Unknown or unavailable encoder %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if (string(argv[i]) == "--size" && i + 1 < argc) {
+                if (!ParseOutputGeometry(argv[++i], geometry)) {
+                    fprintf(stderr, usage, argv[0], argv[0], argv[0], argv[0]);
+                    return 1;
+                }
+            }
+        }
+        //--stream пишет видео, кодировщики изображений к нему не относятся
+        if (stream && encoding_given) {
+            fprintf(stderr, "--encode is not supported with --stream, the output codec follows the video container\n");
+            return 1;
+        }
+        PerspectiveSolver engine(geometry, backend, layout);
+        int code = 0;
+        if (serve) code = RunServer(argv[2], engine, threads, depth > 0 ? depth : 1, encoding);
+        else if (watch) code = RunWatch(argv[2], argv[3], engine, threads, depth > 0 ? depth : 1, encoding);
+        else if (!stream) code = RunBatch(argv[2], engine, threads, profiles, encoding);
+        else {
+            Point2f corners[4];
+            for (int i = 0; i < 4; i++) {
+                corners[i] = Point2f((float)atof(argv[4 + 2 * i]), (float)atof(argv[5 + 2 * i]));
+            }
+            code = RunStream(argv[2], argv[3], corners, engine, depth > 0 ? depth : 1);
+        }
+
+        if (!trace.empty() && !ProfileWriteTrace(trace)) fprintf(stderr, "Failed to write %s\n", trace.c_str());
+        return code;
+    }
+
+    PerspectiveSolver solver; //!<движок исправления перспективы, окно только передает ему данные
+    bool fast_warp = false; //!<исправлять собственным векторным ядром вместо cv::warpPerspective
+    bool gray_output = false; //!<исправлять сразу в серое, для документов
+    OutputGeometry geometry; //!<как выбирать размер исправленного изображения
+    SaveOptions save_options; //!<формат и качество сохранения
+    string save_status; //!<итог последнего сохранения для показа
+    string save_error; //!<какое сохранение не удалось
+    vector<HomographyProfile> profiles; //!<сохраненные настройки неподвижных камер
+    string profiles_error; //!<файла профилей может не быть, тогда список пуст
+    ReadProfiles(PROFILES_FILE, profiles, profiles_error);
+    RemapCache remap_cache(RemapCacheDirectory(PROFILES_FILE)); //!<таблицы профилей, считаются один раз
+    int active_profile = -1; //!<выбранный профиль, его углы применяются к каждому новому изображению
+    CameraModel camera; //!<модель камеры последнего выбранного профиля, остается и после ручной правки углов
+    static char profile_name[64] = ""; //!<имя для сохранения текущей рамки профилем
+
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         return 1;
 
+    //glfwTerminate при любом выходе из main. Все, что зовет GLFW из других потоков, объявлено ниже
+    //и поэтому разрушается раньше: очередь сохранения дорабатывает задания, пока GLFW еще жив
+    struct GlfwSession { ~GlfwSession() { glfwTerminate(); } } glfw_session;
+    SaveQueue save_queue(2, 16, []() { RequestRedraw(); glfwPostEmptyEvent(); }); //!<кодирует и пишет исправленные изображения в фоновых потоках, готовый отчет будит окно
+
     // Decide GL+GLSL versions
 #if __APPLE__
     // GL 3.2 + GLSL 150
@@ -338,39 +349,65 @@ int main(int, char**)
     // Setup Dear ImGui style
     ImGui::StyleColorsDark();
 
+    //обработчики перерисовки ставим до ImGui: он запомнит их и будет вызывать после своих
+    glfwSetMouseButtonCallback(window, redraw_mouse_button_callback);
+    glfwSetScrollCallback(window, redraw_scroll_callback);
+    glfwSetKeyCallback(window, redraw_key_callback);
+    glfwSetCharCallback(window, redraw_char_callback);
+    glfwSetCursorPosCallback(window, redraw_cursor_callback);
+    glfwSetCursorEnterCallback(window, redraw_focus_callback);
+    glfwSetWindowFocusCallback(window, redraw_focus_callback);
+    glfwSetWindowRefreshCallback(window, redraw_window_callback);
+    glfwSetFramebufferSizeCallback(window, redraw_size_callback);
+
     // Setup Platform/Renderer bindings
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-    //   
-    bool show_start_window = true; //!<   
-    bool show_picture_window = false; //!<    
-
-    int click_counter = 0; //!<   
-    int save_counter = 0; //!<      
+    //флаги показа окон 
+    bool show_start_window = true; //!<флаг показа стартового окна
+    bool show_picture_window = false; //!<флаг показа окна с изображениями
+    bool show_timings = false; //!<флаг показа окна с временем стадий
 
-    float SizeImg = 0; //!<   
+    int click_counter = 0; //!<счетчик кликов на изображение
+    int save_counter = 0; //!<счетчик сохранений для формирования названия новой картинки
 
-    Point2f points[4] = { Point2f(0,0),Point2f(0,0),Point2f(0,0),Point2f(0,0) };//!<    
-    Point2f border[4] = { Point2f(0, 0),Point2f(500, 0), Point2f(0, 500), Point2f(500, 500) }; //!<  
+    Point2f points[4] = { Point2f(0,0),Point2f(0,0),Point2f(0,0),Point2f(0,0) };//!<куда нажал пользователь на изображении
 
-    Mat CVimg;//!< 
-    Mat ClearCVimg;//!<    Mat-
+    Mat ClearCVimg;//!<оригинальное загруженное изображение в Mat-переменной, единственная декодированная копия
+    PreviewPyramid preview;//!<уменьшенные копии изображения, для предпросмотра при перетаскивании угла
+    TiledImageView source_view;//!<левое изображение: плитки уровней preview с увеличением и сдвигом
+    future<PreviewImage> loading;//!<фоновая загрузка изображения, пока она идет, future валиден
+    string loading_path;//!<какое изображение загружается
+    bool quad_ready = false;//!<все четыре угла отмечены и отсортированы, показываем рамку
+    int dragged_corner = -1;//!<какой угол сейчас перетаскивается мышью
+    GLTexture live_texture;//!<исправление уменьшенной копии, показывается во время перетаскивания угла
+    Mat live_result;//!<буфер исправления для предпросмотра, переиспользуется каждый кадр
 
-    Mat mat; //!<  
-    Mat result; //!<  
+    Mat mat; //!<матрица исправления искажени
+    Mat result; //!<результат исправления искажения
 
-    ImVec2 pos; //!<   
+    ImVec2 pos; //!<позиция курсора при клике
     
 
-    float koef = 1; //!<   ,    1024px
+    float koef = 1; //!< коэфициент масштабирования картинки, если она больше 1024px
+    bool item_hovered = false; //!<в прошлом кадре курсор был над элементом, ему может понадобиться подсказка
     
     // Main loop
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        //пока на экране ничего не меняется, спим до события: ввода, конца загрузки или сохранения.
+        //Во время загрузки рисуем каждый кадр, там крутится индикатор; готовое сохранение само будит окно.
+        //Пробуждение без событий рисует кадр, только если курсор над элементом и пора показать подсказку
+        if (redraw_frames > 0 || loading.valid()) glfwPollEvents();
+        else {
+            if (item_hovered) glfwWaitEventsTimeout(IDLE_TIMEOUT);
+            else glfwWaitEvents();
+            if (redraw_frames == 0 && !item_hovered) continue;
+        }
+        if (redraw_frames > 0) redraw_frames--;
 
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -378,7 +415,7 @@ int main(int, char**)
         ImGui::NewFrame();
 
         if(show_start_window){
-            //   
+            //флаги оформления стартовой страницы
              ImGuiWindowFlags window_flags = 0;
 
              window_flags |= ImGuiWindowFlags_NoCollapse;
@@ -386,17 +423,17 @@ int main(int, char**)
              window_flags |= ImGuiWindowFlags_NoResize;
              window_flags |= ImGuiWindowFlags_NoScrollbar;
        
-            //   
+            //размер и позиция окна
             ImGui::SetNextWindowPos(ImVec2(0, 0));
             ImGui::SetNextWindowSize(ImVec2(300,75));
-            glfwSetWindowSize(window, 300, 75);
+            ResizeWindow(window, 300, 75);
 
             ImGui::Begin("Choose a file", NULL, window_flags);
        
-            // popup ,        
+            //описывем popup окно, которое откроем в случае ошибки при открытии изображения
             if (ImGui::BeginPopupModal("empty", NULL, ImGuiWindowFlags_AlwaysAutoResize))
             {
-                ImGui::Text(error1);
+                ImGui::Text("%s", error1);
                 ImGui::Separator();
 
                 if (ImGui::Button("OK", ImVec2(130, 0))) { ImGui::CloseCurrentPopup(); }
@@ -407,35 +444,56 @@ int main(int, char**)
 
             ImGui::InputText("Enter a path", buf1, 64);
 
-            if (ImGui::Button("GO!")) {
-                //      
-                if (OK(buf1, error1)) {
-                    //  ,      . 
-                    show_picture_window = true; 
-                    show_start_window = false;
-
-                    std::string SaveTo(buf1);
-                    SaveTo = SaveTo.substr(0, SaveTo.find_last_of("\\/")) + "/";//  ,  
-                    if (string(buf1) == SaveTo) SaveTo = "";
-             
-                    LoadTextureFromFile(buf1,&my_image_texture,&my_image_width,&my_image_height);
-
-                    CVimg = imread(buf1);
-                    ClearCVimg = imread(buf1);
-
-                    strcpy(buf1, SaveTo.c_str());
-                }
+            if (loading.valid()) {
+                //пока изображение декодируется в фоне, окно продолжает рисоваться и крутит индикатор
+                ImGui::Text("Loading %c", "|/-\\"[(int)(ImGui::GetTime() / 0.1) & 3]);
+
+                if (loading.wait_for(chrono::seconds(0)) == future_status::ready) {
+                    PreviewImage loaded = loading.get();
+                    error1 = SolverStatusText(loaded.status);
+                    if (loaded.status == SOLVER_OK) {
+                        //закрывем стартовое окно, и открываем окно с загруженным изображением. 
+                        show_picture_window = true; 
+                        show_start_window = false;
+
+                        std::string SaveTo(loading_path);
+                        SaveTo = SaveTo.substr(0, SaveTo.find_last_of("\\/")) + "/";//отбрасываем имя файла, получая путь
+                        if (loading_path == SaveTo) SaveTo = "";
+
+                        ClearCVimg = loaded.full;
+                        preview = loaded.pyramid;
+                        koef = loaded.koef;
+                        my_image_width = ClearCVimg.cols;
+                        my_image_height = ClearCVimg.rows;
+
+                        //в текстуру загружаем уменьшенную копию под размер показа, полное изображение остается только для исправления
+                        //левое изображение показывается по плиткам всех уровней, поэтому его можно увеличивать
+                        source_view.SetImage(preview);
+                        RequestRedraw();
+
+                        strcpy(buf1, SaveTo.c_str());
+                    }
 
-                else {
-                    //   ,   popup   
-                    ImGui::OpenPopup("empty");
+                    else {
+                        //если изображение не открылось, то вызывем popup окно об ошибке
+                        ImGui::OpenPopup("empty");
+                    }
                 }
             }
+            else if (ImGui::Button("GO!")) {
+                //декодирование и уменьшение идут в фоновом потоке, результат заберем, когда он будет готов
+                loading_path = buf1;
+                loading = async(launch::async, [solver, loading_path]() {
+                    PreviewImage loaded = LoadPreviewImage(solver, loading_path, 1024);
+                    glfwPostEmptyEvent(); //будим окно, если оно ждет событий
+                    return loaded;
+                });
+            }
             ImGui::End();
         }
 
         if (show_picture_window) {
-            //  
+            //описывем характеристики окна
             ImGuiStyle& style = ImGui::GetStyle();
             ImGuiWindowFlags window_flags = 0;
 
@@ -444,83 +502,163 @@ int main(int, char**)
             window_flags |= ImGuiWindowFlags_NoResize;
             ImGui::SetNextWindowPos(ImVec2(0, 0));
            
-            //       1024px,         
-            if (my_image_width > 1024 || my_image_height > 1024) {
-                if (my_image_height > my_image_width) { (float) koef = (float)my_image_height / 1024.0; }
-                else { koef = (float)(my_image_width / 1024.0); }
-            }
-
-            ImGui::SetNextWindowSize(ImVec2((my_image_width + my2_image_width)/koef, height(my_image_height, my2_image_height, koef) + style.WindowPadding.y+55));
-            glfwSetWindowSize(window, (my_image_width + my2_image_width )/koef, height(my_image_height,my2_image_height,koef) + style.WindowPadding.y+55);
+            ImGui::SetNextWindowSize(ImVec2((my_image_width + my2_image_width)/koef, height(my_image_height, my2_image_height, koef) + style.WindowPadding.y+80));
+            ResizeWindow(window, (my_image_width + my2_image_width )/koef, height(my_image_height,my2_image_height,koef) + style.WindowPadding.y+80);
 
             ImGui::Begin("OpenGL Texture Text",NULL,window_flags);
 
-            //      
-            ImGui::Image((void*)(intptr_t)my_image_texture, ImVec2(my_image_width/koef, my_image_height/koef));
+            //подгружаем изображение где будем нажимать на точки: колесо увеличивает, правая кнопка двигает
+            source_view.Draw("##source", ImVec2(my_image_width/koef, my_image_height/koef));
+            if (source_view.Pending()) RequestRedraw();
+            ImVec2 image_pos = source_view.Origin(); //!<где на экране пиксель (0, 0) полного изображения
+            float view_koef = 1 / source_view.Zoom(); //!<сколько пикселей изображения в пикселе экрана при текущем увеличении
+            ImVec2 view_min = ImGui::GetItemRectMin();
+            ImVec2 view_max = ImGui::GetItemRectMax();
+
+            //рамка правой картинки: тот же масштаб, что у левой, но не больше 1024px на экране
+            //без профиля размер считается по углам без дисторсии, как у таблицы с моделью камеры
+            auto output_size = [&]() {
+                if (active_profile >= 0) return profiles[active_profile].size;
+                Point2f undistorted[4];
+                UndistortCorners(camera, points, undistorted);
+                return solver.OutputSize(undistorted);
+            };
+            auto fit_output = [&]() {
+                Size output = output_size();
+                float fit = min(1.0f, 1024 * koef / max(output.width, output.height));
+                my2_image_width = max(1, (int)(output.width * fit));
+                my2_image_height = max(1, (int)(output.height * fit));
+            };
+
+            //исправление в полном разрешении для уже отмеченных четырех углов
+            auto solve_quad = [&]() {
+                //сортируем точки под тот формат массива точек, который требует opencv
+                SortPoints(points);
+
+                //получаем скорректированное изображение в новом буфере: старый, возможно, еще сохраняется в фоне
+                result.release();
+                shared_ptr<const RemapTable> table;
+                RemapTable lens;
+                if (active_profile >= 0 && remap_cache.Table(solver, profiles[active_profile], table) == SOLVER_OK) {
+                    solver.Warp(ClearCVimg, *table, result);
+                }
+                //рамку профиля поправили вручную: дисторсию снимаем тем же remap по новым углам
+                else if (!camera.Empty() && solver.BuildRemap(points, camera, INTER_LINEAR, lens) == SOLVER_OK) {
+                    solver.Warp(ClearCVimg, lens, result);
+                }
+                else solver.Warp(ClearCVimg, points, result);
+
+                fit_output();
+
+                //привязываем результирующее исправленное изображение к текстуре правого изображения
+                BindCVMat2GLTexture(result, my2_image_texture);
+                RequestRedraw();
+
+                quad_ready = true;
+                mat.release();
+            };
+
+            //выбранный профиль сразу применяется к новому изображению, углы отмечать не нужно
+            auto apply_profile = [&]() {
+                for (int i = 0; i < 4; i++) points[i] = profiles[active_profile].corners[i];
+                camera = profiles[active_profile].camera;
+                click_counter = 0;
+                dragged_corner = -1;
+                solve_quad();
+            };
+            if (active_profile >= 0 && !quad_ready && click_counter == 0 && dragged_corner < 0) apply_profile();
+
+            //угол готовой рамки можно схватить и перетащить, не отмечая все четыре заново
+            if (quad_ready && dragged_corner < 0 && ImGui::IsItemHovered() && HitCorner(ImGui::GetMousePos(), image_pos, points, view_koef, 8) >= 0) {
+                ImGui::SetMouseCursor(ImGuiMouseCursor_Hand);
+            }
+            if (quad_ready && dragged_corner < 0 && ImGui::IsItemClicked()) {
+                dragged_corner = HitCorner(ImGui::GetMousePos(), image_pos, points, view_koef, 8);
+                if (dragged_corner >= 0) active_profile = -1; //рамка правится вручную и больше не совпадает с профилем, модель камеры остается
+            }
 
-            //    
-            if (ImGui::IsItemClicked())
+            if (dragged_corner >= 0) {
+                //угол следует за курсором, но не выходит за изображение
+                pos = ImGui::GetMousePos();
+                points[dragged_corner].x = min(max((pos.x - image_pos.x) * view_koef, 0.0f), (float)my_image_width);
+                points[dragged_corner].y = min(max((pos.y - image_pos.y) * view_koef, 0.0f), (float)my_image_height);
+
+                if (ImGui::IsMouseDown(0)) {
+                    SOLVER_PROFILE_SCOPE("live_preview");
+
+                    //каждый кадр исправляем уменьшенную копию сразу в размер показа, это укладывается в кадр даже для больших снимков
+                    int top = preview.Levels() - 1;
+                    float scale = (float)preview.Scale(top);
+                    Point2f scaled[4];
+                    for (int i = 0; i < 4; i++) scaled[i] = Point2f(points[i].x / scale, points[i].y / scale);
+
+                    fit_output();
+                    Size live_size(max(1, (int)(my2_image_width / koef)), max(1, (int)(my2_image_height / koef)));
+                    //цветной предпросмотр сразу в BGRA текстуры, без отдельного перевода перед загрузкой
+                    WarpLayout live_layout = solver.Layout() == WARP_LAYOUT_GRAY ? WARP_LAYOUT_GRAY : WARP_LAYOUT_BGRA;
+                    SolverStatus live_status;
+                    if (camera.Empty()) live_status = solver.Warp(preview.Top(), scaled, live_result, live_size, live_layout);
+                    else {
+                        //модель камеры в пикселях уменьшенной копии, таблица размера показа строится за кадр
+                        CameraModel live_camera = camera;
+                        live_camera.fx /= scale;
+                        live_camera.fy /= scale;
+                        live_camera.cx /= scale;
+                        live_camera.cy /= scale;
+                        RemapTable live_table;
+                        live_status = solver.BuildRemap(scaled, live_camera, INTER_LINEAR, live_table, live_size);
+                        if (live_status == SOLVER_OK) live_status = solver.Warp(preview.Top(), live_table, live_result, live_layout);
+                    }
+                    if (live_status == SOLVER_OK) {
+                        BindCVMat2GLTexture(live_result, live_texture);
+                        RequestRedraw();
+                    }
+                }
+                else {
+                    //кнопку отпустили: один раз исправляем полное изображение
+                    dragged_corner = -1;
+                    solve_quad();
+                    live_texture.Release();
+                }
+            }
+            //обрабатывем щелчки по изображению слева
+            else if (ImGui::IsItemClicked())
             {
-                //            
+                //записывем место щелчка относительно левого верхнего угла изображения
                 pos = ImGui::GetMousePos();
-                pos.x -= style.WindowPadding.x;
-                pos.y -= style.WindowPadding.y;
+                pos.x -= image_pos.x;
+                pos.y -= image_pos.y;
 
                 if (click_counter <= 3) {
-                    //   ,  
-                    points[click_counter].x = pos.x*koef;
-                    points[click_counter].y = pos.y*koef;
-
-                    //     
-                    circle(CVimg, Point(pos.x*koef, pos.y*koef), 5, (0, 0, 255), -1);
-
-                    //    ,        
-                    BindCVMat2GLTexture(CVimg, my_image_texture);
+                    //пишем в массив точек, куда нажали, кружок на этом месте нарисуется поверх изображения
+                    points[click_counter].x = pos.x*view_koef;
+                    points[click_counter].y = pos.y*view_koef;
+                    quad_ready = false;
+                    active_profile = -1;
                     click_counter++;
 
-                    //    
+                    //обработка финального клика по изображению
                     if (click_counter == 4) {
-
-                        //      ,   opencv
-                        SortPoints(points);
-
-                        //       
-                        SizeImg = CalcPicSize(points);
-
-                        //   ,          
-                        if (SizeImg < 100) {
-                            SizeImg *= 5;
-                        }
-
-                        //  , 
+                        //сбрасываем счетчик кликов, 
                         click_counter = 0;
-
-                        //  
-                        cv::warpPerspective(ClearCVimg, result, getPerspectiveTransform(points, border), Size(500, 500));
-
-                        //  ,    
-                        my2_image_height = SizeImg;
-                        my2_image_width = SizeImg;
-
-                        //       
-                        BindCVMat2GLTexture(result, my2_image_texture);
-
-                        glDeleteTextures(1, &my_image_texture);
-                        //     ,    
-                        BindCVMat2GLTexture(ClearCVimg, my_image_texture);
-                        CVimg.release();
-                        mat.release();
-                        // opencv     
-                        CVimg = ClearCVimg.clone();
+                        solve_quad();
                     }
                 }
             }
 
-            //      ,    
+            //синие кружки и рамка рисуются ImGui поверх неизменной текстуры
+            //при увеличении углы за краем области не рисуются
+            ImGui::GetWindowDrawList()->PushClipRect(view_min, view_max, true);
+            if (click_counter > 0) DrawCorners(ImGui::GetWindowDrawList(), image_pos, points, click_counter, view_koef, false);
+            else if (quad_ready) DrawCorners(ImGui::GetWindowDrawList(), image_pos, points, 4, view_koef, true);
+            ImGui::GetWindowDrawList()->PopClipRect();
+
+            //на той же строке выводим текстуру изображения, где будем показывать результат
             ImGui::SameLine();
-            ImGui::Image((void*)(intptr_t)my2_image_texture, ImVec2(my2_image_width/koef, my2_image_height/koef));
+            GLuint shown = dragged_corner >= 0 && live_texture.Id() != 0 ? live_texture.Id() : my2_image_texture.Id();
+            ImGui::Image((void*)(intptr_t)shown, ImVec2(my2_image_width/koef, my2_image_height/koef));
 
-            //      
+            //описываем окно для ввода пути для сохранения
             if (ImGui::BeginPopupModal("saveLink", NULL, ImGuiWindowFlags_AlwaysAutoResize))
             {
                 ImGui::Text("Enter a path where to save");
@@ -534,10 +672,11 @@ int main(int, char**)
                 ImGui::EndPopup();
             }
 
-            //      
+            //описываем окно для сообщения об ошибке сохранения
             if (ImGui::BeginPopupModal("saveError", NULL, ImGuiWindowFlags_AlwaysAutoResize))
             {
                 ImGui::Text("Something went wrong while saving :(");
+                ImGui::Text("%s", save_error.c_str());
                 ImGui::Separator();
 
                 if (ImGui::Button("OK", ImVec2(130, 0))) { ImGui::CloseCurrentPopup(); }
@@ -546,31 +685,202 @@ int main(int, char**)
                 ImGui::EndPopup();
             }
 
-            //    ,   
+            //сохранение в то же место, откуда открывали изображение
             if (ImGui::Button("Save")) {
                 //std::string SaveTo(buf1);
-                //SaveTo = SaveTo.substr(0, SaveTo.find_last_of("\\/")) + "/";//  ,  
+                //SaveTo = SaveTo.substr(0, SaveTo.find_last_of("\\/")) + "/";//отбрасываем имя файла, получая путь
                 //char* where = new char[SaveTo.length() + 1];
                 //strcpy(where, SaveTo.c_str());
 
-                Save(buf1, result, save_counter);
+                SolverStatus status = Save(save_queue, buf1, result, save_options, save_counter);
+                if (status != SOLVER_OK) {
+                    save_error = SolverStatusText(status);
+                    ImGui::OpenPopup("saveError");
+                }
+            }
+
+            //забираем итоги фоновых сохранений
+            SaveReport report;
+            while (save_queue.Poll(report)) {
+                if (report.status == SOLVER_OK) {
+                    save_status = "Saved " + report.path + ": " + to_string(report.bytes / 1024) + " KB, " + report.encoder + " " + to_string((int)(report.encode_seconds * 1000))
+                        + " ms, total " + to_string((int)(report.seconds * 1000)) + " ms";
+                }
+                else {
+                    save_error = report.path + ": " + SolverStatusText(report.status);
+                    ImGui::OpenPopup("saveError");
+                }
             }
             
 
-            //    
+            //выбор ядра исправления, действует со следующего исправления
+            ImGui::SameLine();
+            if (ImGui::Checkbox("Fast warp", &fast_warp)) {
+                solver = PerspectiveSolver(geometry, fast_warp ? WARP_SIMD : WARP_OPENCV, solver.Layout());
+            }
+
+            //серый результат для документов, при смене сразу переисправляем отмеченную рамку
+            ImGui::SameLine();
+            if (ImGui::Checkbox("Gray", &gray_output)) {
+                solver = PerspectiveSolver(geometry, solver.Backend(), gray_output ? WARP_LAYOUT_GRAY : WARP_LAYOUT_SOURCE);
+                if (quad_ready && dragged_corner < 0) solve_quad();
+            }
+
+            //размер результата, при смене сразу переисправляем отмеченную рамку
+            const char* modes[] = { "500x500", "From quad", "A4", "Letter" };
+            int mode = geometry.mode == OUTPUT_FIXED ? 0 : geometry.mode == OUTPUT_QUAD ? 1 : 2 + geometry.paper;
+            bool geometry_changed = false;
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(90);
+            if (ImGui::Combo("##output", &mode, modes, 4)) {
+                geometry.mode = mode == 0 ? OUTPUT_FIXED : mode == 1 ? OUTPUT_QUAD : OUTPUT_PAPER;
+                geometry.paper = mode == 3 ? PAPER_LETTER : PAPER_A4;
+                geometry_changed = true;
+            }
+            if (geometry.mode == OUTPUT_PAPER) {
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(80);
+                if (ImGui::InputInt("DPI", &geometry.dpi, 50, 100)) {
+                    geometry.dpi = min(max(geometry.dpi, 0), MAX_DPI);
+                    geometry_changed = true;
+                }
+            }
+            if (geometry_changed) {
+                solver = PerspectiveSolver(geometry, solver.Backend(), solver.Layout());
+                active_profile = -1;
+                if (quad_ready && dragged_corner < 0) solve_quad();
+            }
+#ifndef SOLVER_NO_PROFILE
+            ImGui::SameLine();
+            ImGui::Checkbox("Timings", &show_timings);
+#endif
+
+            //профили неподвижных камер: выбор применяет углы и размер, кнопка сохраняет текущую рамку
+            ImGui::SetNextItemWidth(120);
+            if (ImGui::BeginCombo("##profile", active_profile >= 0 ? profiles[active_profile].name.c_str() : "No profile")) {
+                if (ImGui::Selectable("No profile", active_profile < 0) && (active_profile >= 0 || !camera.Empty())) {
+                    //явный выбор "без профиля" снимает и модель камеры
+                    active_profile = -1;
+                    camera = CameraModel();
+                    if (quad_ready) solve_quad();
+                }
+                for (int i = 0; i < (int)profiles.size(); i++) {
+                    if (ImGui::Selectable(profiles[i].name.c_str(), i == active_profile)) {
+                        active_profile = i;
+                        apply_profile();
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            if (active_profile < 0 && !camera.Empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("Lens correction");
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Save profile") && quad_ready) ImGui::OpenPopup("saveProfile");
+            if (ImGui::BeginPopupModal("saveProfile", NULL, ImGuiWindowFlags_AlwaysAutoResize))
+            {
+                ImGui::InputText("Profile name", profile_name, 64);
+                ImGui::Separator();
+
+                if (ImGui::Button("OK", ImVec2(130, 0)) && profile_name[0] != 0) {
+                    HomographyProfile profile;
+                    profile.name = profile_name;
+                    for (int i = 0; i < 4; i++) profile.corners[i] = points[i];
+                    profile.size = output_size();
+                    profile.camera = camera;
+
+                    //профиль с тем же именем перезаписываем, его модель камеры из файла сохраняется, если своей у рамки нет
+                    const HomographyProfile* existing = FindProfile(profiles, profile.name);
+                    if (existing != NULL) {
+                        if (profile.camera.Empty()) profile.camera = existing->camera;
+                        active_profile = (int)(existing - profiles.data());
+                        profiles[active_profile] = profile;
+                    }
+                    else {
+                        profiles.push_back(profile);
+                        active_profile = (int)profiles.size() - 1;
+                    }
+                    camera = profile.camera;
+                    save_status = WriteProfiles(PROFILES_FILE, profiles) ? "Profile saved to " + string(PROFILES_FILE) : "Failed to save profiles";
+                    ImGui::CloseCurrentPopup();
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Cancel", ImVec2(130, 0))) { ImGui::CloseCurrentPopup(); }
+
+                ImGui::EndPopup();
+            }
+
+            //формат и настройки кодировщика, недоступные в этой сборке форматы не выбираются
+            ImGui::SameLine();
+            const char* formats[] = { "JPEG", "PNG", "WebP", "JPEG XL" };
+            ImGui::SetNextItemWidth(80);
+            if (ImGui::BeginCombo("##format", formats[save_options.format])) {
+                for (int f = 0; f < SAVE_FORMAT_COUNT; f++) {
+                    if (ImGui::Selectable(formats[f], f == save_options.format, EncoderAvailable((SaveFormat)f) ? 0 : ImGuiSelectableFlags_Disabled)) save_options.format = (SaveFormat)f;
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(120);
+            switch (save_options.format) {
+            case SAVE_JPEG: {
+                ImGui::SliderInt("Quality", &save_options.jpeg_quality, 0, 100);
+                //без поддержки прореживания выбор ничего бы не менял, поэтому его не показываем
+                if (JpegSubsamplingAvailable()) {
+                    const char* subsamplings[] = { "4:4:4", "4:2:2", "4:2:0" };
+                    int subsampling = save_options.jpeg_subsampling;
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(70);
+                    if (ImGui::Combo("##subsampling", &subsampling, subsamplings, 3)) save_options.jpeg_subsampling = (JpegSubsampling)subsampling;
+                }
+                ImGui::SameLine();
+                ImGui::Checkbox("Progressive", &save_options.jpeg_progressive);
+                break;
+            }
+            case SAVE_PNG: {
+                ImGui::SliderInt("Level", &save_options.png_compression, 0, 9);
+                const char* strategies[] = { "Default", "Filtered", "Huffman", "RLE", "Fixed" };
+                int strategy = save_options.png_strategy;
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(80);
+                if (ImGui::Combo("##strategy", &strategy, strategies, 5)) save_options.png_strategy = (PngStrategy)strategy;
+                break;
+            }
+            case SAVE_WEBP: {
+                bool lossless = save_options.webp_quality > 100;
+                if (!lossless) ImGui::SliderInt("Quality", &save_options.webp_quality, 1, 100);
+                else ImGui::TextDisabled("Quality");
+                ImGui::SameLine();
+                if (ImGui::Checkbox("Lossless", &lossless)) save_options.webp_quality = lossless ? 101 : 90;
+                break;
+            }
+            default: ImGui::SliderInt("Effort", &save_options.jxl_effort, 1, 9); break;
+            }
+            ImGui::SameLine();
+            size_t pending = save_queue.Pending();
+            if (pending > 0) ImGui::Text("Saving %d...", (int)pending);
+            else ImGui::Text("%s", save_status.c_str());
+
+            //кнопка отката на стартовую страницу
             if (ImGui::Button("Back")) {
                 show_start_window = true; 
                 show_picture_window = false;
 
-                // ,   
+                //чистим все, куда сохраняли графику
                 mat.release();
                 result.release();
 
-                CVimg.release();
                 ClearCVimg.release();
+                preview.Release();
+                click_counter = 0;
+                quad_ready = false;
+                dragged_corner = -1;
+                live_texture.Release();
+                live_result.release();
 
-                glDeleteTextures(1, &my_image_texture);
-                glDeleteTextures(1, &my2_image_texture);
+                source_view.Release();
+                my2_image_texture.Release();
 
                 koef = 1; 
 
@@ -587,6 +897,25 @@ int main(int, char**)
             ImGui::End();
         }
 
+#ifndef SOLVER_NO_PROFILE
+        //время стадий по последним замерам, трассировку можно открыть в chrome://tracing
+        if (show_timings) {
+            ImGui::Begin("Timings", &show_timings, ImGuiWindowFlags_AlwaysAutoResize);
+            ImGui::Text("%-16s %9s %9s %9s %7s", "stage", "last ms", "avg ms", "max ms", "count");
+            for (const ProfileStage& stage : ProfileStages()) {
+                ImGui::Text("%-16s %9.2f %9.2f %9.2f %7lld", stage.name.c_str(), stage.last_ms, stage.average_ms, stage.max_ms, (long long)stage.count);
+            }
+            if (ImGui::Button("Save trace")) {
+                save_status = ProfileWriteTrace("solver_trace.json") ? "Trace saved to solver_trace.json" : "Failed to save trace";
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset")) ProfileReset();
+            ImGui::End();
+        }
+#endif
+
+        item_hovered = ImGui::IsAnyItemHovered();
+
         // Rendering
         ImGui::Render();
         int display_w, display_h;
@@ -600,12 +929,15 @@ int main(int, char**)
     }
 
     // Cleanup
+    source_view.Release();
+    my2_image_texture.Release();
+    live_texture.Release();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glfwDestroyWindow(window);
-    glfwTerminate();
 
     return 0;
 }
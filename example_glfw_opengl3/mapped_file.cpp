@@ -0,0 +1,146 @@
+#include "mapped_file.h"
+
+#include <climits>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data(NULL), size(0), file(INVALID_HANDLE_VALUE), mapping(NULL)
+{
+}
+
+bool MappedFile::Open(const string& path)
+{
+    Close();
+
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length) || length.QuadPart == 0 || length.QuadPart > INT_MAX) {
+        Close();
+        return false;
+    }
+    size = (size_t)length.QuadPart;
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != NULL) UnmapViewOfFile(data);
+    if (mapping != NULL) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    data = NULL;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+    size = 0;
+}
+
+void PrefetchFile(const string&)
+{
+    //в Windows упреждающее чтение файлов делает сам диспетчер кэша
+}
+
+#else
+
+MappedFile::MappedFile() : data(NULL), size(0)
+{
+}
+
+bool MappedFile::Open(const string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0 || info.st_size > INT_MAX) {
+        close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //отображение остается действительным и без дескриптора
+    if (mapped == MAP_FAILED) return false;
+
+    data = mapped;
+    size = (size_t)info.st_size;
+
+    //декодер прочитает файл целиком и по порядку
+    madvise(data, size, MADV_WILLNEED);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data != NULL) munmap(data, size);
+    data = NULL;
+    size = 0;
+}
+
+void PrefetchFile(const string& path)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+Mat MappedFile::Bytes() const
+{
+    if (data == NULL) return Mat();
+    return Mat(1, (int)size, CV_8U, data);
+}
+
+bool ReadFileBytes(const string& path, Mat& bytes)
+{
+    bytes.release();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) return false;
+
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) : -1;
+    ok = ok && size > 0 && size <= INT_MAX && fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        bytes.create(1, (int)size, CV_8U);
+        //файл укоротили во время чтения - прочитано меньше, чем ожидали
+        ok = fread(bytes.ptr(), 1, (size_t)size, file) == (size_t)size;
+    }
+    fclose(file);
+    if (!ok) bytes.release();
+    return ok;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+/*!
+Файл, отображенный в память только для чтения.
+Bytes() возвращает заголовок Mat прямо над отображением, поэтому cv::imdecode читает файл без копирования
+в промежуточный буфер. Заголовок действителен, пока файл открыт.
+Если файл укорачивают, пока он отображен, обращение к пропавшим страницам завершает процесс сигналом SIGBUS,
+поэтому файлы, которые могут переписать во время чтения, надо читать через ReadFileBytes.
+*/
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /*!
+    Отображает файл в память и просит ядро заранее прочитать его целиком
+    \param[in] path Путь до файла
+    \returns false если файл не открылся, пустой, больше 2 ГБ или не отображается
+    */
+    bool Open(const std::string& path);
+
+    /*!
+    Снимает отображение
+    */
+    void Close();
+
+    /*!
+    Содержимое файла: одна строка CV_8U без копирования, пустая если файл не открыт
+    */
+    cv::Mat Bytes() const;
+
+    size_t Size() const { return size; }
+
+private:
+    void* data; //!<начало отображения
+    size_t size; //!<длина файла
+#ifdef _WIN32
+    void* file; //!<HANDLE файла
+    void* mapping; //!<HANDLE отображения
+#endif
+};
+
+/*!
+Читает файл целиком в память обычным чтением, без отображения. Медленнее MappedFile на копию,
+зато укороченный во время чтения файл дает ошибку, а не SIGBUS
+\param[in] path Путь до файла
+\param[out] bytes Содержимое файла, одна строка CV_8U
+\returns false если файл не открылся, пустой, больше 2 ГБ или изменился во время чтения
+*/
+bool ReadFileBytes(const std::string& path, cv::Mat& bytes);
+
+/*!
+Просит ядро начать читать файл в кэш в фоне, не дожидаясь чтения. Используется для следующих
+заданий пакетной обработки, чтобы к их началу файл уже был в памяти. Ошибки игнорируются.
+\param[in] path Путь до файла
+*/
+void PrefetchFile(const std::string& path);
@@ -0,0 +1,38 @@
+#include "preview.h"
+#include "profiler.h"
+
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+void PreviewPyramid::Build(const Mat& full, Size display)
+{
+    SOLVER_PROFILE_SCOPE("preview_pyramid");
+    levels.clear();
+    if (full.empty()) return;
+
+    levels.push_back(full);
+
+    //уменьшаем вдвое, пока следующий уровень не станет меньше размера показа
+    while (levels.back().cols / 2 >= display.width && levels.back().rows / 2 >= display.height &&
+           levels.back().cols > 1 && levels.back().rows > 1) {
+        Mat next;
+        pyrDown(levels.back(), next);
+        levels.push_back(next);
+    }
+}
+
+PreviewImage LoadPreviewImage(const PerspectiveSolver& solver, const string& path, int max_side)
+{
+    PreviewImage image;
+    image.status = solver.Load(path, image.full);
+    if (image.status != SOLVER_OK) return image;
+
+    //если загруженная картинка не влезает на стандартные max_side px, то посчитаем коэффициент на который будем изменять ее размер
+    int longest = max(image.full.cols, image.full.rows);
+    if (longest > max_side) image.koef = (float)longest / max_side;
+
+    image.pyramid.Build(image.full, Size((int)(image.full.cols / image.koef), (int)(image.full.rows / image.koef)));
+    return image;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "solver.h"
+
+/*!
+Уменьшенные копии изображения для показа на экране.
+Нулевой уровень - само изображение (без копирования), каждый следующий вдвое меньше (cv::pyrDown).
+Уровни строятся только до того, который еще не меньше размера показа, поэтому в видеопамять
+можно загружать последний уровень, а полное изображение оставить в памяти процессора для сохранения.
+*/
+class PreviewPyramid
+{
+public:
+    /*!
+    Строит уровни для показа изображения в заданном размере
+    \param[in] full Полное изображение
+    \param[in] display Размер, в котором изображение будет показано
+    */
+    void Build(const cv::Mat& full, cv::Size display);
+
+    /*!
+    Удаляет все уровни
+    */
+    void Release() { levels.clear(); }
+
+    int Levels() const { return (int)levels.size(); }
+    const cv::Mat& Level(int i) const { return levels[i]; }
+
+    /*!
+    Самый маленький уровень, который еще не меньше размера показа
+    */
+    const cv::Mat& Top() const { return levels.back(); }
+
+    /*!
+    Во сколько раз уровень меньше полного изображения по ширине
+    \param[in] i Номер уровня
+    */
+    double Scale(int i) const { return (double)levels[0].cols / levels[i].cols; }
+
+private:
+    std::vector<cv::Mat> levels; //!<уровни от полного изображения к самому маленькому
+};
+
+/*!
+Изображение, подготовленное к показу: полное для исправления и уменьшенные копии для экрана
+*/
+struct PreviewImage
+{
+    SolverStatus status = SOLVER_DECODE_FAILED; //!<результат загрузки
+    cv::Mat full; //!<полное декодированное изображение
+    PreviewPyramid pyramid; //!<уменьшенные копии для показа
+    float koef = 1; //!<во сколько раз изображение уменьшено на экране
+};
+
+/*!
+Загружает изображение и строит уменьшенные копии для показа.
+Не обращается к OpenGL, поэтому может выполняться в фоновом потоке, пока окно продолжает рисоваться.
+\param[in] solver Движок, который загружает изображение
+\param[in] path Путь до изображения
+\param[in] max_side Наибольшая сторона изображения на экране
+\returns подготовленное изображение, при ошибке только status
+*/
+PreviewImage LoadPreviewImage(const PerspectiveSolver& solver, const std::string& path, int max_side = 1024);
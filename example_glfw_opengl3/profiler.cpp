@@ -0,0 +1,183 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+/*!
+Одно событие трассировки
+*/
+struct TraceEvent
+{
+    const char* name;
+    int64_t start_us;
+    int64_t duration_us;
+    int thread;
+};
+
+/*!
+Скользящее окно замеров стадии
+*/
+struct StageSamples
+{
+    double samples[PROFILE_WINDOW] = {}; //!<кольцо последних замеров в миллисекундах
+    int64_t count = 0;
+    int64_t first_us = 0; //!<начало первого замера, по нему стадии упорядочиваются при слиянии потоков
+    int64_t last_us = 0; //!<конец последнего замера
+};
+
+/*!
+Замеры одного потока. Записывает в них только сам поток, поэтому его мьютекс почти всегда свободен
+и нужен лишь на время слияния в ProfileStages и ProfileWriteTrace
+*/
+struct ThreadProfile
+{
+    mutex lock;
+    map<const char*, StageSamples> stages; //!<по указателю имени: без построения строки на каждый замер
+    vector<TraceEvent> events;
+    int thread = 0; //!<короткий номер потока для трассировки
+};
+
+static mutex registry_mutex; //!<защищает threads, берется один раз на поток и при слиянии
+static vector<shared_ptr<ThreadProfile>> threads; //!<замеры всех потоков, переживают сами потоки
+static atomic<size_t> event_count(0); //!<событий во всех потоках, для общего ограничения PROFILE_MAX_EVENTS
+
+static const chrono::steady_clock::time_point process_start = chrono::steady_clock::now();
+
+int64_t ProfileNow()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - process_start).count();
+}
+
+/*!
+Замеры текущего потока, при первом обращении регистрируются в общем списке
+*/
+static ThreadProfile& CurrentThreadProfile()
+{
+    thread_local shared_ptr<ThreadProfile> current;
+    if (!current) {
+        current = make_shared<ThreadProfile>();
+        lock_guard<mutex> lock(registry_mutex);
+        current->thread = (int)threads.size();
+        threads.push_back(current);
+    }
+    return *current;
+}
+
+void ProfileRecord(const char* name, int64_t start_us, int64_t duration_us)
+{
+    ThreadProfile& profile = CurrentThreadProfile();
+    lock_guard<mutex> lock(profile.lock);
+
+    auto found = profile.stages.find(name);
+    if (found == profile.stages.end()) {
+        found = profile.stages.emplace(name, StageSamples()).first;
+        found->second.first_us = start_us;
+    }
+    StageSamples& stage = found->second;
+    stage.samples[stage.count % PROFILE_WINDOW] = duration_us / 1000.0;
+    stage.count++;
+    stage.last_us = start_us + duration_us;
+
+    if (event_count.fetch_add(1, memory_order_relaxed) < PROFILE_MAX_EVENTS) {
+        profile.events.push_back(TraceEvent{ name, start_us, duration_us, profile.thread });
+    }
+    else event_count.fetch_sub(1, memory_order_relaxed);
+}
+
+vector<ProfileStage> ProfileStages()
+{
+    //одна и та же стадия в разных потоках (и литералы с одним текстом в разных файлах) сливается по имени
+    struct MergedStage
+    {
+        ProfileStage item;
+        int64_t first_us = 0;
+        int64_t last_us = -1;
+        double sum_ms = 0;
+        int filled = 0;
+    };
+    map<string, MergedStage> merged;
+
+    lock_guard<mutex> registry_lock(registry_mutex);
+    for (const shared_ptr<ThreadProfile>& profile : threads) {
+        lock_guard<mutex> lock(profile->lock);
+        for (const auto& found : profile->stages) {
+            const StageSamples& stage = found.second;
+            if (stage.count == 0) continue;
+            auto inserted = merged.emplace(found.first, MergedStage());
+            MergedStage& target = inserted.first->second;
+            if (inserted.second) {
+                target.item.name = found.first;
+                target.first_us = stage.first_us;
+            }
+            target.first_us = min(target.first_us, stage.first_us);
+            target.item.count += stage.count;
+            if (stage.last_us > target.last_us) {
+                target.last_us = stage.last_us;
+                target.item.last_ms = stage.samples[(stage.count - 1) % PROFILE_WINDOW];
+            }
+            int filled = (int)min<int64_t>(stage.count, PROFILE_WINDOW);
+            for (int i = 0; i < filled; i++) {
+                target.sum_ms += stage.samples[i];
+                target.item.max_ms = max(target.item.max_ms, stage.samples[i]);
+            }
+            target.filled += filled;
+        }
+    }
+
+    vector<MergedStage*> order;
+    for (auto& found : merged) {
+        found.second.item.average_ms = found.second.sum_ms / found.second.filled;
+        order.push_back(&found.second);
+    }
+    sort(order.begin(), order.end(), [](const MergedStage* a, const MergedStage* b) { return a->first_us < b->first_us; });
+
+    vector<ProfileStage> result;
+    for (const MergedStage* stage : order) {
+        result.push_back(stage->item);
+    }
+    return result;
+}
+
+bool ProfileWriteTrace(const string& path)
+{
+    //события потоков собираются в один список по времени начала
+    vector<TraceEvent> events;
+    {
+        lock_guard<mutex> registry_lock(registry_mutex);
+        for (const shared_ptr<ThreadProfile>& profile : threads) {
+            lock_guard<mutex> lock(profile->lock);
+            events.insert(events.end(), profile->events.begin(), profile->events.end());
+        }
+    }
+    sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.start_us < b.start_us; });
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) return false;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& event = events[i];
+        fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}%s\n", event.name,
+            (long long)event.start_us, (long long)event.duration_us, event.thread, i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    return fclose(file) == 0;
+}
+
+void ProfileReset()
+{
+    lock_guard<mutex> registry_lock(registry_mutex);
+    for (const shared_ptr<ThreadProfile>& profile : threads) {
+        lock_guard<mutex> lock(profile->lock);
+        profile->stages.clear();
+        profile->events.clear();
+    }
+    event_count = 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+Статистика одной стадии по последним замерам
+*/
+struct ProfileStage
+{
+    std::string name; //!<имя стадии
+    double last_ms = 0; //!<последний замер
+    double average_ms = 0; //!<среднее по последним PROFILE_WINDOW замерам каждого потока
+    double max_ms = 0; //!<максимум по последним PROFILE_WINDOW замерам каждого потока
+    int64_t count = 0; //!<сколько всего было замеров
+};
+
+const int PROFILE_WINDOW = 120; //!<по скольким последним замерам считается статистика
+const size_t PROFILE_MAX_EVENTS = 1 << 20; //!<ограничение числа событий трассировки в памяти
+
+/*!
+Микросекунды от запуска процесса
+*/
+int64_t ProfileNow();
+
+/*!
+Записывает замер стадии, можно вызывать из любого потока. Замеры копятся отдельно в каждом потоке
+без общей блокировки, стадии сливаются по имени только в ProfileStages и ProfileWriteTrace
+\param[in] name Имя стадии, строка должна жить до конца программы (обычно литерал)
+\param[in] start_us Начало, ProfileNow()
+\param[in] duration_us Длительность в микросекундах
+*/
+void ProfileRecord(const char* name, int64_t start_us, int64_t duration_us);
+
+/*!
+Статистика всех стадий в порядке первого замера
+*/
+std::vector<ProfileStage> ProfileStages();
+
+/*!
+Записывает все события в формате Chrome trace_event (открывается в chrome://tracing и Perfetto)
+\param[in] path Куда сохранить JSON
+\returns получилось ли записать файл
+*/
+bool ProfileWriteTrace(const std::string& path);
+
+/*!
+Забывает все замеры и события
+*/
+void ProfileReset();
+
+#ifndef SOLVER_NO_PROFILE
+
+/*!
+Замеряет время от создания до разрушения и записывает его как стадию name
+*/
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name), start(ProfileNow()) {}
+    ~ProfileScope() { ProfileRecord(name, start, ProfileNow() - start); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define SOLVER_PROFILE_CONCAT_(a, b) a##b
+#define SOLVER_PROFILE_CONCAT(a, b) SOLVER_PROFILE_CONCAT_(a, b)
+//! Замеряет стадию до конца текущего блока; при SOLVER_NO_PROFILE не оставляет в коде ничего
+#define SOLVER_PROFILE_SCOPE(name) ProfileScope SOLVER_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+#else
+
+#define SOLVER_PROFILE_SCOPE(name) ((void)0)
+
+#endif
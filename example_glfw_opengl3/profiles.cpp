@@ -0,0 +1,332 @@
+#include "profiles.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include <opencv2/core/utils/filesystem.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+/*!
+Заголовок файла таблицы на диске, за ним идут данные map1 и map2 построчно без выравнивания
+*/
+struct RemapFileHeader
+{
+    char magic[8]; //!<"REMAP01"
+    int32_t width; //!<размер результата
+    int32_t height;
+    int32_t interpolation; //!<флаг OpenCV
+    int32_t map1_type; //!<тип map1
+    int32_t map2_type; //!<тип map2, -1 если map2 пустая
+    uint64_t key; //!<хэш ключа профиля, защищает от чужого файла с тем же именем
+};
+
+static const char REMAP_MAGIC[8] = "REMAP01";
+
+static const struct { const char* name; int flag; } interpolations[] = {
+    { "nearest", INTER_NEAREST },
+    { "linear", INTER_LINEAR },
+    { "cubic", INTER_CUBIC },
+    { "lanczos", INTER_LANCZOS4 }
+};
+
+bool ParseInterpolation(const string& text, int& interpolation)
+{
+    for (const auto& item : interpolations) {
+        if (text == item.name) {
+            interpolation = item.flag;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* InterpolationName(int interpolation)
+{
+    for (const auto& item : interpolations) {
+        if (interpolation == item.flag) return item.name;
+    }
+    return "linear";
+}
+
+bool ReadProfiles(const string& path, vector<HomographyProfile>& profiles, string& error)
+{
+    ifstream file(path);
+    if (!file.is_open()) {
+        error = "Failed to open profiles " + path;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+    while (getline(file, line)) {
+        line_number++;
+
+        //пропускаем пустые строки и комментарии
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') continue;
+
+        istringstream fields(line);
+        HomographyProfile profile;
+        string size, interpolation;
+        fields >> quoted(profile.name);
+        for (int i = 0; i < 4; i++) {
+            fields >> profile.corners[i].x >> profile.corners[i].y;
+        }
+        fields >> size >> interpolation;
+
+        OutputGeometry geometry;
+        if (fields.fail() || profile.name.empty() || !ParseOutputGeometry(size, geometry) || geometry.mode != OUTPUT_FIXED
+            || !ParseInterpolation(interpolation, profile.interpolation)) {
+            error = path + ":" + to_string(line_number) + ": expected \"name x1 y1 x2 y2 x3 y3 x4 y4 WxH nearest|linear|cubic|lanczos\"";
+            return false;
+        }
+        profile.size = geometry.size;
+
+        //необязательная модель камеры: 4, 5 или 8 коэффициентов
+        string camera;
+        if (fields >> camera) {
+            int count = 0;
+            fields >> profile.camera.fx >> profile.camera.fy >> profile.camera.cx >> profile.camera.cy;
+            bool ok = camera == "camera" && !fields.fail() && !profile.camera.Empty();
+            while (ok && count < 8 && fields >> profile.camera.distortion[count]) count++;
+            if (!ok || !(count == 4 || count == 5 || count == 8) || !(fields >> ws).eof()) {
+                error = path + ":" + to_string(line_number) + ": expected \"camera fx fy cx cy k1 k2 p1 p2 [k3 [k4 k5 k6]]\" after the interpolation";
+                return false;
+            }
+        }
+        profiles.push_back(profile);
+    }
+    return true;
+}
+
+bool WriteProfiles(const string& path, const vector<HomographyProfile>& profiles)
+{
+    ofstream file(path);
+    if (!file.is_open()) return false;
+
+    file << "# name x1 y1 x2 y2 x3 y3 x4 y4 WxH interpolation\n";
+    //точность как у RemapKey: после сохранения и загрузки ключ тот же, и таблица на диске находится
+    file << setprecision(9);
+    for (const HomographyProfile& profile : profiles) {
+        file << quoted(profile.name);
+        for (int i = 0; i < 4; i++) {
+            file << " " << profile.corners[i].x << " " << profile.corners[i].y;
+        }
+        file << " " << profile.size.width << "x" << profile.size.height << " " << InterpolationName(profile.interpolation);
+        if (!profile.camera.Empty()) {
+            file << " camera " << profile.camera.fx << " " << profile.camera.fy << " " << profile.camera.cx << " " << profile.camera.cy;
+            for (double k : profile.camera.distortion) {
+                file << " " << k;
+            }
+        }
+        file << "\n";
+    }
+    file.close();
+    return !file.fail();
+}
+
+const HomographyProfile* FindProfile(const vector<HomographyProfile>& profiles, const string& name)
+{
+    for (const HomographyProfile& profile : profiles) {
+        if (profile.name == name) return &profile;
+    }
+    return NULL;
+}
+
+string RemapCacheDirectory(const string& profiles_path)
+{
+    return profiles_path + ".cache";
+}
+
+/*!
+Ключ таблицы: все, от чего она зависит. Имя не входит, переименованный профиль использует ту же таблицу
+*/
+static string RemapKey(const HomographyProfile& profile)
+{
+    ostringstream key;
+    key << setprecision(9);
+    for (int i = 0; i < 4; i++) {
+        key << profile.corners[i].x << " " << profile.corners[i].y << " ";
+    }
+    key << profile.size.width << "x" << profile.size.height << " " << profile.interpolation;
+
+    //без камеры ключ прежний, поэтому уже построенные таблицы остаются действительными
+    if (!profile.camera.Empty()) {
+        key << " camera " << profile.camera.fx << " " << profile.camera.fy << " " << profile.camera.cx << " " << profile.camera.cy;
+        for (double k : profile.camera.distortion) {
+            key << " " << k;
+        }
+    }
+    return key.str();
+}
+
+/*!
+FNV-1a, в отличие от std::hash одинаковый на всех компиляторах, поэтому годится для имен файлов
+*/
+static uint64_t RemapKeyHash(const string& key)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*!
+Читает и записывает данные Mat построчно, у таблиц из convertMaps строки могут быть с выравниванием
+*/
+static bool ReadRows(FILE* file, Mat& mat)
+{
+    for (int y = 0; y < mat.rows; y++) {
+        size_t length = mat.cols * mat.elemSize();
+        if (fread(mat.ptr(y), 1, length, file) != length) return false;
+    }
+    return true;
+}
+
+static bool WriteRows(FILE* file, const Mat& mat)
+{
+    for (int y = 0; y < mat.rows; y++) {
+        size_t length = mat.cols * mat.elemSize();
+        if (fwrite(mat.ptr(y), 1, length, file) != length) return false;
+    }
+    return true;
+}
+
+/*!
+Читает таблицу с диска
+\returns false если файла нет или он не для этого профиля
+*/
+static bool LoadRemap(const string& path, uint64_t key, const HomographyProfile& profile, RemapTable& table)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) return false;
+
+    RemapFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, REMAP_MAGIC, sizeof(REMAP_MAGIC)) == 0
+        && header.key == key && header.width == profile.size.width && header.height == profile.size.height
+        && header.interpolation == profile.interpolation
+        && (header.map1_type == CV_16SC2 || header.map1_type == CV_32FC2) && (header.map2_type == CV_16UC1 || header.map2_type == -1);
+    if (ok) {
+        Size size(header.width, header.height);
+        table.map1.create(size, header.map1_type);
+        if (header.map2_type >= 0) table.map2.create(size, header.map2_type);
+        else table.map2.release();
+        table.interpolation = header.interpolation;
+        ok = ReadRows(file, table.map1) && ReadRows(file, table.map2);
+    }
+    fclose(file);
+    return ok;
+}
+
+/*!
+Записывает таблицу на диск через временный файл, чтобы параллельные процессы не прочитали половину.
+Имя временного файла состоит из номера процесса и потока: у двух процессов с общей папкой кэша хэши потоков могут совпасть
+*/
+static void StoreRemap(const string& path, uint64_t key, const RemapTable& table)
+{
+    string temporary = path + "." + to_string((long long)getpid()) + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) return;
+
+    RemapFileHeader header = {};
+    memcpy(header.magic, REMAP_MAGIC, sizeof(REMAP_MAGIC));
+    header.width = table.map1.cols;
+    header.height = table.map1.rows;
+    header.interpolation = table.interpolation;
+    header.map1_type = table.map1.type();
+    header.map2_type = table.map2.empty() ? -1 : table.map2.type();
+    header.key = key;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && WriteRows(file, table.map1) && WriteRows(file, table.map2);
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) remove(temporary.c_str());
+}
+
+RemapCache::RemapCache(const string& directory) : directory(directory)
+{
+}
+
+SolverStatus RemapCache::Table(const PerspectiveSolver& solver, const HomographyProfile& profile, shared_ptr<const RemapTable>& table)
+{
+    string key = RemapKey(profile);
+    promise<BuiltTable> building;
+    shared_future<BuiltTable> pending;
+    bool builder = false;
+    {
+        lock_guard<mutex> lock(tables_mutex);
+        auto found = tables.find(key);
+        if (found != tables.end()) pending = found->second;
+        else {
+            pending = building.get_future().share();
+            tables.emplace(key, pending);
+            builder = true;
+        }
+    }
+
+    //таблицу строим без блокировки: другие профили в это время берутся из памяти,
+    //а потоки с тем же профилем ждут эту таблицу, а не строят еще одну такую же
+    if (builder) {
+        BuiltTable built;
+        try
+        {
+            built = Build(solver, profile, key);
+        }
+        catch (const std::exception&)
+        {
+            built.status = SOLVER_WARP_FAILED;
+        }
+        if (built.status != SOLVER_OK) {
+            //неудачу не запоминаем, следующий запрос попробует снова
+            lock_guard<mutex> lock(tables_mutex);
+            tables.erase(key);
+        }
+        building.set_value(built);
+    }
+
+    const BuiltTable& result = pending.get();
+    table = result.table;
+    return result.status;
+}
+
+RemapCache::BuiltTable RemapCache::Build(const PerspectiveSolver& solver, const HomographyProfile& profile, const string& key) const
+{
+    BuiltTable result;
+    uint64_t hash = RemapKeyHash(key);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.remap", (unsigned long long)hash);
+    string path = directory.empty() ? string() : utils::fs::join(directory, name);
+
+    shared_ptr<RemapTable> built = make_shared<RemapTable>();
+    if (path.empty() || !LoadRemap(path, hash, profile, *built)) {
+        result.status = solver.BuildRemap(profile.corners, profile.camera, profile.interpolation, *built, profile.size);
+        if (result.status != SOLVER_OK) return result;
+
+        if (!path.empty() && utils::fs::createDirectories(directory)) StoreRemap(path, hash, *built);
+    }
+
+    result.table = built;
+    return result;
+}
+
+void RemapCache::Clear()
+{
+    lock_guard<mutex> lock(tables_mutex);
+    tables.clear();
+}
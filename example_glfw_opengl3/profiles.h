@@ -0,0 +1,126 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "solver.h"
+
+const char* const PROFILES_FILE = "profiles.txt"; //!<файл профилей по умолчанию, в текущей папке
+
+/*!
+Сохраненная настройка неподвижной камеры: углы листа, размер результата, интерполяция и, если камера откалибрована,
+модель ее объектива. Профиль применяется к новому снимку без отметки углов
+*/
+struct HomographyProfile
+{
+    std::string name; //!<имя профиля
+    cv::Point2f corners[4]; //!<углы документа на снимке, в любом порядке
+    cv::Size size = cv::Size(500, 500); //!<размер результата
+    int interpolation = cv::INTER_LINEAR; //!<cv::INTER_NEAREST, INTER_LINEAR, INTER_CUBIC или INTER_LANCZOS4
+    CameraModel camera; //!<дисторсия объектива, снимается тем же remap, что и перспектива; пустая если не нужна
+};
+
+/*!
+Разбирает название интерполяции: "nearest", "linear", "cubic" или "lanczos"
+\param[in] text Название
+\param[out] interpolation Флаг OpenCV
+\returns true если название распознано
+*/
+bool ParseInterpolation(const std::string& text, int& interpolation);
+
+/*!
+\param[in] interpolation Флаг OpenCV
+\returns Название для файла профилей
+*/
+const char* InterpolationName(int interpolation);
+
+/*!
+Читает файл профилей.
+Каждая непустая строка имеет вид "name x1 y1 x2 y2 x3 y3 x4 y4 WxH interpolation [camera fx fy cx cy k1 k2 p1 p2 [k3 [k4 k5 k6]]]",
+имена с пробелами берутся в кавычки, строки начинающиеся с # пропускаются.
+Коэффициентов дисторсии 4, 5 или 8, как их выдает cv::calibrateCamera.
+\param[in] path Путь до файла
+\param[out] profiles Прочитанные профили
+\param[out] error Описание ошибки, если файл не прочитался
+\returns true если файл прочитан
+*/
+bool ReadProfiles(const std::string& path, std::vector<HomographyProfile>& profiles, std::string& error);
+
+/*!
+Записывает профили в том же формате, в каком их читает ReadProfiles
+\param[in] path Путь до файла
+\param[in] profiles Профили
+\returns true если файл записан
+*/
+bool WriteProfiles(const std::string& path, const std::vector<HomographyProfile>& profiles);
+
+/*!
+Ищет профиль по имени
+\returns Найденный профиль или NULL
+*/
+const HomographyProfile* FindProfile(const std::vector<HomographyProfile>& profiles, const std::string& name);
+
+/*!
+\param[in] profiles_path Путь до файла профилей
+\returns Папка, где хранятся таблицы этих профилей на диске
+*/
+std::string RemapCacheDirectory(const std::string& profiles_path);
+
+/*!
+Кэш таблиц пересчета координат для профилей.
+Таблица зависит только от углов, размера и интерполяции, поэтому считается один раз на профиль
+и затем хранится в памяти, а если задана папка, то и на диске между запусками.
+Безопасен для вызова из нескольких потоков.
+*/
+class RemapCache
+{
+public:
+    /*!
+    \param[in] directory Папка для таблиц на диске, пустая строка - только в памяти
+    */
+    explicit RemapCache(const std::string& directory = std::string());
+
+    RemapCache(const RemapCache&) = delete;
+    RemapCache& operator=(const RemapCache&) = delete;
+
+    /*!
+    Возвращает таблицу профиля: из памяти, с диска или посчитанную заново.
+    Таблицу строит только первый из потоков, запросивших ее одновременно, остальные ждут готовую
+    \param[in] solver Движок, которым считается матрица исправления
+    \param[in] profile Профиль
+    \param[out] table Таблица, общая для всех, кто ее запросил
+    \returns SOLVER_OK, SOLVER_BAD_CORNERS или SOLVER_WARP_FAILED, если на таблицу не хватило памяти
+    */
+    SolverStatus Table(const PerspectiveSolver& solver, const HomographyProfile& profile, std::shared_ptr<const RemapTable>& table);
+
+    /*!
+    Забывает таблицы в памяти, файлы на диске остаются
+    */
+    void Clear();
+
+private:
+    /*!
+    Таблица вместе с результатом ее построения
+    */
+    struct BuiltTable
+    {
+        SolverStatus status = SOLVER_OK;
+        std::shared_ptr<const RemapTable> table;
+    };
+
+    /*!
+    Загружает таблицу с диска или считает и сохраняет ее
+    */
+    BuiltTable Build(const PerspectiveSolver& solver, const HomographyProfile& profile, const std::string& key) const;
+
+    std::string directory; //!<папка таблиц на диске
+    std::mutex tables_mutex; //!<защищает tables
+    std::map<std::string, std::shared_future<BuiltTable>> tables; //!<таблицы по ключу профиля, в том числе еще строящиеся
+};
@@ -0,0 +1,322 @@
+#include "region_decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <opencv2/imgproc.hpp>
+
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+#ifdef SOLVER_HAVE_LIBTIFF
+#include <mutex>
+#include <tiffio.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+Rect QuadRegion(const Point2f corners[4], Size image_size, int margin)
+{
+    //угол может немного выходить за снимок, но дальше размера изображения - это ошибка,
+    //а nan или 1e30 при переводе в int ниже дали бы неопределенное поведение
+    for (int i = 0; i < 4; i++) {
+        if (!(corners[i].x >= -image_size.width && corners[i].x <= 2.0f * image_size.width
+            && corners[i].y >= -image_size.height && corners[i].y <= 2.0f * image_size.height)) return Rect();
+    }
+
+    float left = corners[0].x, right = corners[0].x, top = corners[0].y, bottom = corners[0].y;
+    for (int i = 1; i < 4; i++) {
+        left = min(left, corners[i].x);
+        right = max(right, corners[i].x);
+        top = min(top, corners[i].y);
+        bottom = max(bottom, corners[i].y);
+    }
+
+    Rect region((int)floor(left) - margin, (int)floor(top) - margin, 0, 0);
+    region.width = (int)ceil(right) + margin + 1 - region.x;
+    region.height = (int)ceil(bottom) + margin + 1 - region.y;
+    return region & Rect(0, 0, image_size.width, image_size.height);
+}
+
+#ifdef SOLVER_HAVE_LIBJPEG_TURBO
+
+/*!
+Ошибки libjpeg возвращаются через longjmp, иначе библиотека завершает процесс
+*/
+struct JpegError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr info)
+{
+    longjmp(((JpegError*)info->err)->jump, 1);
+}
+
+static void JpegSilence(j_common_ptr, int)
+{
+}
+
+/*!
+Читает тег ориентации из блока EXIF
+\returns 1 для обычной ориентации или если тега нет
+*/
+static int JpegOrientation(jpeg_decompress_struct& info)
+{
+    for (jpeg_saved_marker_ptr marker = info.marker_list; marker != NULL; marker = marker->next) {
+        const unsigned char* data = marker->data;
+        unsigned int length = marker->data_length;
+        if (marker->marker != JPEG_APP0 + 1 || length < 14 || memcmp(data, "Exif\0\0", 6) != 0) continue;
+
+        //дальше идет обычный заголовок TIFF: порядок байт, 42 и смещение первого каталога
+        data += 6;
+        length -= 6;
+        if (length < 8 || !(data[0] == 'I' && data[1] == 'I') && !(data[0] == 'M' && data[1] == 'M')) return 1;
+        bool little = data[0] == 'I';
+        auto read16 = [&](unsigned int at) { return little ? data[at] | data[at + 1] << 8 : data[at] << 8 | data[at + 1]; };
+        auto read32 = [&](unsigned int at) { return little ? (unsigned int)(read16(at) | read16(at + 2) << 16) : (unsigned int)(read16(at) << 16 | read16(at + 2)); };
+
+        //смещения в файле не доверяем: проверки без сложения, иначе смещение около UINT_MAX переполняется
+        unsigned int directory = read32(4);
+        if (directory > length - 2) return 1;
+        unsigned int entries = read16(directory);
+        if (entries > (length - directory - 2) / 12) entries = (length - directory - 2) / 12;
+        for (unsigned int i = 0; i < entries; i++) {
+            unsigned int entry = directory + 2 + i * 12;
+            if (read16(entry) == 0x0112) return read16(entry + 8);
+        }
+        return 1;
+    }
+    return 1;
+}
+
+bool DecodeJpegRegion(const Mat& bytes, const Point2f corners[4], int margin, Mat& image, Point& origin)
+{
+    const unsigned char* data = bytes.ptr();
+    if (bytes.total() < 3 || data[0] != 0xFF || data[1] != 0xD8 || data[2] != 0xFF) return false;
+
+    jpeg_decompress_struct info;
+    JpegError error;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = JpegErrorExit;
+    error.manager.emit_message = JpegSilence;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        image.release();
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, data, (unsigned long)bytes.total());
+    jpeg_save_markers(&info, JPEG_APP0 + 1, 0xFFFF);
+    jpeg_read_header(&info, TRUE);
+
+    //imdecode поворачивает изображение по EXIF, и углы отмечены на повернутом. Такие файлы декодируем целиком
+    //CMYK libjpeg не переводит в BGR, их тоже оставляем OpenCV
+    if (JpegOrientation(info) != 1 || (info.jpeg_color_space != JCS_GRAYSCALE && info.jpeg_color_space != JCS_YCbCr && info.jpeg_color_space != JCS_RGB)) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+
+    info.out_color_space = JCS_EXT_BGR;
+    jpeg_start_decompress(&info);
+
+    Rect region = QuadRegion(corners, Size(info.output_width, info.output_height), margin);
+    if (region.empty()) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+
+    //столбцы обрезаются по границе MCU: начало сдвигается влево, ширина растет
+    JDIMENSION x = region.x;
+    JDIMENSION width = region.width;
+    jpeg_crop_scanline(&info, &x, &width);
+
+    //строки выше области пропускаются без обратного DCT
+    if (region.y > 0) jpeg_skip_scanlines(&info, region.y);
+
+    image.create(region.height, (int)width, CV_8UC3);
+    while (info.output_scanline < (JDIMENSION)region.br().y) {
+        JSAMPROW row = image.ptr((int)info.output_scanline - region.y);
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    //строки ниже области не нужны: прерываем декодирование, не дочитывая файл
+    jpeg_destroy_decompress(&info);
+    origin = Point((int)x, region.y);
+    return true;
+}
+
+#else
+
+bool DecodeJpegRegion(const Mat&, const Point2f[4], int, Mat&, Point&)
+{
+    return false;
+}
+
+#endif
+
+#ifdef SOLVER_HAVE_LIBTIFF
+
+/*!
+Файл TIFF в памяти для TIFFClientOpen
+*/
+struct TiffMemory
+{
+    const unsigned char* data;
+    toff_t size;
+    toff_t position;
+};
+
+static tmsize_t TiffRead(thandle_t handle, void* buffer, tmsize_t length)
+{
+    TiffMemory* memory = (TiffMemory*)handle;
+    if (memory->position >= memory->size) return 0;
+    tmsize_t available = (tmsize_t)min<toff_t>((toff_t)length, memory->size - memory->position);
+    memcpy(buffer, memory->data + memory->position, (size_t)available);
+    memory->position += available;
+    return available;
+}
+
+static tmsize_t TiffWrite(thandle_t, void*, tmsize_t)
+{
+    return 0;
+}
+
+static toff_t TiffSeek(thandle_t handle, toff_t offset, int whence)
+{
+    TiffMemory* memory = (TiffMemory*)handle;
+    toff_t base = whence == SEEK_CUR ? memory->position : whence == SEEK_END ? memory->size : 0;
+    memory->position = base + offset;
+    return memory->position;
+}
+
+static int TiffClose(thandle_t)
+{
+    return 0;
+}
+
+static toff_t TiffSize(thandle_t handle)
+{
+    return ((TiffMemory*)handle)->size;
+}
+
+static int TiffMap(thandle_t handle, void** base, toff_t* size)
+{
+    TiffMemory* memory = (TiffMemory*)handle;
+    *base = (void*)memory->data;
+    *size = memory->size;
+    return 1;
+}
+
+//libtiff 4.5 и новее принимает обработчики для одного файла, более старая - только общие на весь процесс
+#if TIFFLIB_VERSION >= 20221213
+#define SOLVER_TIFF_OPEN_OPTIONS 1
+#endif
+
+#ifdef SOLVER_TIFF_OPEN_OPTIONS
+/*!
+Предупреждения libtiff о нестандартных тегах в консоль не нужны. Ненулевой результат не пускает их в общий обработчик
+*/
+static int TiffSilence(TIFF*, void*, const char*, const char*, va_list)
+{
+    return 1;
+}
+#endif
+
+static void TiffUnmap(thandle_t, void*, toff_t)
+{
+}
+
+bool DecodeTiffRegion(const Mat& bytes, const Point2f corners[4], int margin, Mat& image, Point& origin)
+{
+    const unsigned char* data = bytes.ptr();
+    if (bytes.total() < 4 || !(memcmp(data, "II*\0", 4) == 0 || memcmp(data, "MM\0*", 4) == 0)) return false;
+
+    TiffMemory memory = { data, (toff_t)bytes.total(), 0 };
+#ifdef SOLVER_TIFF_OPEN_OPTIONS
+    //предупреждения глушим только у своего файла: общий обработчик нужен другим пользователям libtiff в процессе
+    TIFFOpenOptions* options = TIFFOpenOptionsAlloc();
+    if (options == NULL) return false;
+    TIFFOpenOptionsSetWarningHandlerExtR(options, TiffSilence, NULL);
+    TIFF* tiff = TIFFClientOpenExt("memory", "rm", (thandle_t)&memory, TiffRead, TiffWrite, TiffSeek, TiffClose, TiffSize, TiffMap, TiffUnmap, options);
+    TIFFOpenOptionsFree(options);
+#else
+    //старая libtiff: общий обработчик снимаем один раз, а не при каждом декодировании из разных потоков
+    static once_flag silenced;
+    call_once(silenced, []() { TIFFSetWarningHandler(NULL); });
+    TIFF* tiff = TIFFClientOpen("memory", "rm", (thandle_t)&memory, TiffRead, TiffWrite, TiffSeek, TiffClose, TiffSize, TiffMap, TiffUnmap);
+#endif
+    if (tiff == NULL) return false;
+
+    uint32_t width = 0, height = 0, tile_width = 0, tile_height = 0;
+    uint16_t bits = 8, samples = 1, planar = PLANARCONFIG_CONTIG, photometric = 0, orientation = ORIENTATION_TOPLEFT;
+    TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+    TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation);
+
+    //полосовые, 16-битные, палитровые, YCbCr и повернутые файлы оставляем OpenCV
+    bool gray = photometric == PHOTOMETRIC_MINISBLACK && samples == 1;
+    bool color = photometric == PHOTOMETRIC_RGB && (samples == 3 || samples == 4);
+    if (!TIFFIsTiled(tiff) || bits != 8 || planar != PLANARCONFIG_CONTIG || orientation != ORIENTATION_TOPLEFT || !(gray || color)
+        || !TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tile_width) || !TIFFGetField(tiff, TIFFTAG_TILELENGTH, &tile_height)
+        || tile_width == 0 || tile_height == 0) {
+        TIFFClose(tiff);
+        return false;
+    }
+
+    Rect region = QuadRegion(corners, Size((int)width, (int)height), margin);
+    if (region.empty()) {
+        TIFFClose(tiff);
+        return false;
+    }
+
+    //расширяем область до границ тайлов, чтобы каждый тайл читался один раз и целиком
+    int left = region.x / (int)tile_width * (int)tile_width;
+    int top = region.y / (int)tile_height * (int)tile_height;
+    int right = min((int)width, region.br().x);
+    int bottom = min((int)height, region.br().y);
+
+    Mat decoded(bottom - top, right - left, CV_8UC(samples));
+    vector<unsigned char> tile((size_t)TIFFTileSize(tiff));
+    bool ok = true;
+    for (int y = top; y < bottom && ok; y += (int)tile_height) {
+        for (int x = left; x < right && ok; x += (int)tile_width) {
+            ok = TIFFReadTile(tiff, tile.data(), (uint32_t)x, (uint32_t)y, 0, 0) >= 0;
+
+            //крайние тайлы выступают за изображение, копируем только попавшую в область часть
+            int rows = min((int)tile_height, bottom - y);
+            int columns = min((int)tile_width, right - x);
+            for (int row = 0; row < rows && ok; row++) {
+                memcpy(decoded.ptr(y - top + row) + (size_t)(x - left) * samples, &tile[(size_t)row * tile_width * samples], (size_t)columns * samples);
+            }
+        }
+    }
+    TIFFClose(tiff);
+    if (!ok) return false;
+
+    if (samples == 1) cvtColor(decoded, image, COLOR_GRAY2BGR);
+    else if (samples == 3) cvtColor(decoded, image, COLOR_RGB2BGR);
+    else cvtColor(decoded, image, COLOR_RGBA2BGR);
+    origin = Point(left, top);
+    return true;
+}
+
+#else
+
+bool DecodeTiffRegion(const Mat&, const Point2f[4], int, Mat&, Point&)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+const int REGION_MARGIN = 4; //!<запас вокруг четырехугольника в пикселях, хватает окрестности 8x8 для INTER_LANCZOS4 и лишний столбец на краю обрезки JPEG
+
+/*!
+Прямоугольник, который нужен для исправления четырехугольника
+\param[in] corners Углы документа в любом порядке
+\param[in] image_size Размер всего изображения
+\param[in] margin Запас вокруг углов для интерполяции
+\returns Ограничивающий прямоугольник углов с запасом, обрезанный по изображению, пустой если углы вне изображения,
+не конечны или отстоят от изображения дальше его размера
+*/
+cv::Rect QuadRegion(const cv::Point2f corners[4], cv::Size image_size, int margin);
+
+/*!
+Декодирует из JPEG только строки и столбцы MCU, которые пересекают четырехугольник
+(jpeg_crop_scanline и jpeg_skip_scanlines из libjpeg-turbo). Собирается с SOLVER_HAVE_LIBJPEG_TURBO,
+иначе всегда возвращает false.
+\param[in] bytes Содержимое файла, одна строка CV_8U
+\param[in] corners Углы документа в любом порядке
+\param[in] margin Запас вокруг углов
+\param[out] image Декодированная часть изображения в формате BGR, может быть чуть больше запрошенной из-за выравнивания по MCU
+\param[out] origin Где на полном изображении лежит левый верхний пиксель image
+\returns false если это не JPEG, libjpeg-turbo не подключена, файл поврежден, повернут тегом EXIF
+или его цвета не переводятся в BGR. Тогда нужно декодировать файл целиком
+*/
+bool DecodeJpegRegion(const cv::Mat& bytes, const cv::Point2f corners[4], int margin, cv::Mat& image, cv::Point& origin);
+
+/*!
+Декодирует из тайлового TIFF только тайлы, которые пересекают четырехугольник.
+Собирается с SOLVER_HAVE_LIBTIFF, иначе всегда возвращает false.
+\param[in] bytes Содержимое файла, одна строка CV_8U
+\param[in] corners Углы документа в любом порядке
+\param[in] margin Запас вокруг углов
+\param[out] image Декодированные тайлы в формате BGR
+\param[out] origin Где на полном изображении лежит левый верхний пиксель image
+\returns false если это не тайловый 8-битный TIFF с серыми, RGB или RGBA пикселями в обычной ориентации,
+libtiff не подключена или файл поврежден. Тогда нужно декодировать файл целиком
+*/
+bool DecodeTiffRegion(const cv::Mat& bytes, const cv::Point2f corners[4], int margin, cv::Mat& image, cv::Point& origin);
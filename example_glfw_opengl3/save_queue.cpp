@@ -0,0 +1,90 @@
+#include "save_queue.h"
+
+#include <chrono>
+
+using namespace std;
+using namespace cv;
+
+SaveQueue::SaveQueue(int threads, size_t capacity, function<void()> notify) : capacity(capacity), notify(notify), active(0), stopping(false)
+{
+    if (threads < 1) threads = 1;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&SaveQueue::Worker, this);
+    }
+}
+
+SaveQueue::~SaveQueue()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+SolverStatus SaveQueue::Push(const string& path, const Mat& image, const SaveOptions& options)
+{
+    if (image.empty()) return SOLVER_EMPTY_RESULT;
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (jobs.size() >= capacity) return SOLVER_QUEUE_FULL;
+        jobs.push_back(Job{ path, image, options });
+    }
+    wake.notify_one();
+    return SOLVER_OK;
+}
+
+bool SaveQueue::Poll(SaveReport& report)
+{
+    lock_guard<std::mutex> lock(mutex);
+    if (reports.empty()) return false;
+    report = reports.front();
+    reports.pop_front();
+    return true;
+}
+
+size_t SaveQueue::Pending()
+{
+    lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + active;
+}
+
+void SaveQueue::Worker()
+{
+    for (;;) {
+        Job job;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+            //при остановке сначала дописываем все принятые задания
+            if (jobs.empty()) return;
+
+            job = move(jobs.front());
+            jobs.pop_front();
+            active++;
+        }
+
+        auto started = chrono::steady_clock::now();
+
+        SaveReport report;
+        EncodeStats stats;
+        report.path = job.path;
+        report.encoder = EncoderName(job.options.format);
+        report.status = SaveImage(job.path, job.image, job.options, stats);
+        report.encode_seconds = stats.seconds;
+        report.bytes = stats.bytes;
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            reports.push_back(report);
+            active--;
+        }
+        if (notify) notify();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "solver.h"
+#include "encoders.h"
+
+/*!
+Итог одного сохранения
+*/
+struct SaveReport
+{
+    std::string path; //!<куда сохранялось изображение
+    SolverStatus status = SOLVER_OK; //!<результат сохранения
+    double seconds = 0; //!<сколько заняло кодирование и запись
+    double encode_seconds = 0; //!<из них только кодирование
+    size_t bytes = 0; //!<размер записанного файла
+    const char* encoder = ""; //!<чем кодировалось, EncoderName
+};
+
+/*!
+Очередь фонового сохранения.
+Кодирование и запись выполняют несколько собственных потоков, окно только кладет задания в очередь
+и раз в кадр забирает готовые отчеты. Очередь ограничена, чтобы не копить в памяти неограниченно много изображений.
+Формат и кодировщик выбираются для каждого задания отдельно, задания разных форматов кодируются параллельно.
+При уничтожении очередь дожидается сохранения всех принятых изображений.
+*/
+class SaveQueue
+{
+public:
+    /*!
+    \param[in] threads Количество потоков кодирования
+    \param[in] capacity Сколько изображений может ждать сохранения одновременно
+    \param[in] notify Вызывается из потока сохранения после каждого отчета, например чтобы разбудить окно
+    */
+    explicit SaveQueue(int threads = 2, size_t capacity = 16, std::function<void()> notify = std::function<void()>());
+    ~SaveQueue();
+
+    SaveQueue(const SaveQueue&) = delete;
+    SaveQueue& operator=(const SaveQueue&) = delete;
+
+    /*!
+    Ставит изображение в очередь на сохранение.
+    Очередь хранит ссылку на пиксели изображения, а не копию, поэтому после вызова их нельзя менять,
+    новое изображение надо создавать в новом буфере.
+    \param[in] path Путь, куда сохранить
+    \param[in] image Изображение
+    \param[in] options Настройки кодирования
+    \returns SOLVER_OK, SOLVER_EMPTY_RESULT если сохранять нечего или SOLVER_QUEUE_FULL если очередь заполнена
+    */
+    SolverStatus Push(const std::string& path, const cv::Mat& image, const SaveOptions& options);
+
+    /*!
+    Забирает отчет о завершенном сохранении, не блокируется
+    \param[out] report Отчет
+    \returns был ли готовый отчет
+    */
+    bool Poll(SaveReport& report);
+
+    /*!
+    Сколько изображений еще ждут сохранения или сохраняются
+    */
+    size_t Pending();
+
+private:
+    struct Job
+    {
+        std::string path;
+        cv::Mat image;
+        SaveOptions options;
+    };
+
+    void Worker();
+
+    size_t capacity; //!<ограничение длины очереди
+    std::function<void()> notify; //!<сообщает о готовом отчете, может быть пустой
+
+    std::mutex mutex;
+    std::condition_variable wake; //!<будит потоки при новом задании или остановке
+    std::deque<Job> jobs; //!<ждущие задания
+    std::deque<SaveReport> reports; //!<готовые отчеты
+    size_t active; //!<сколько заданий кодируется прямо сейчас
+    bool stopping; //!<очередь уничтожается
+
+    std::vector<std::thread> workers;
+};
@@ -0,0 +1,361 @@
+#include "server.h"
+#include "bounded_queue.h"
+#include "save_queue.h"
+
+#include <atomic>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+#if defined(__linux__) || defined(__APPLE__)
+
+static const size_t MAX_HEADER = 16 * 1024; //!<ограничение строки запроса и заголовков
+static const size_t MAX_BODY = 256 << 20; //!<ограничение размера присланного изображения
+static const int IO_TIMEOUT = 10; //!<сколько секунд ждать медленного клиента
+static const int MAX_REQUEST_DPI = 600; //!<ограничение dpi запроса: A4 при 600 dpi - около 100 МБ на поток
+static const long long MAX_REQUEST_PIXELS = 4961LL * 7016; //!<ограничение площади результата запроса при любом size: столько же, сколько у A4 при MAX_REQUEST_DPI
+
+static volatile sig_atomic_t stop_requested = 0; //!<пришел SIGINT или SIGTERM
+
+static void OnStopSignal(int)
+{
+    stop_requested = 1;
+}
+
+/*!
+Разобранный HTTP-запрос
+*/
+struct HttpRequest
+{
+    string method; //!<GET, POST...
+    string path; //!<путь без параметров
+    string query; //!<все после '?'
+    Mat body; //!<тело запроса, одна строка CV_8U, сразу готово для cv::imdecode
+};
+
+/*!
+Записывает все буферы одним системным вызовом writev, досылая остаток при частичной записи.
+Буферы не склеиваются и не копируются.
+*/
+static bool WriteAll(int fd, iovec* parts, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(fd, parts, count);
+        if (written < 0) return false;
+
+        //пропускаем полностью записанные буферы и сдвигаем начало частично записанного
+        while (count > 0 && (size_t)written >= parts->iov_len) {
+            written -= parts->iov_len;
+            parts++;
+            count--;
+        }
+        if (count > 0) {
+            parts->iov_base = (char*)parts->iov_base + written;
+            parts->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+/*!
+Отправляет ответ: заголовок и тело уходят из разных буферов
+*/
+static void Respond(int fd, int code, const char* reason, const char* type, const void* data, size_t size)
+{
+    char header[256];
+    int length = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+        code, reason, type, size);
+
+    iovec parts[2] = { { header, (size_t)length }, { (void*)data, size } };
+    WriteAll(fd, parts, size > 0 ? 2 : 1);
+}
+
+/*!
+Отправляет ответ с текстом ошибки
+*/
+static void RespondError(int fd, int code, const char* reason, const string& message)
+{
+    string text = message + "\n";
+    Respond(fd, code, reason, "text/plain", text.data(), text.size());
+}
+
+/*!
+Читает запрос целиком. Тело читается сразу в буфер Mat, без промежуточных копий кроме того,
+что пришло одним пакетом с заголовками.
+\returns 0 или HTTP-код ошибки
+*/
+static int ReadRequest(int fd, HttpRequest& request)
+{
+    string head;
+    size_t end = string::npos;
+    char chunk[4096];
+    while (end == string::npos) {
+        if (head.size() > MAX_HEADER) return 431;
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got <= 0) return 400;
+        head.append(chunk, got);
+        end = head.find("\r\n\r\n");
+    }
+
+    //строка запроса: METHOD /path?query HTTP/1.1
+    size_t line_end = head.find("\r\n");
+    string line = head.substr(0, line_end);
+    size_t first_space = line.find(' ');
+    size_t second_space = line.find(' ', first_space + 1);
+    if (first_space == string::npos || second_space == string::npos) return 400;
+    request.method = line.substr(0, first_space);
+    string target = line.substr(first_space + 1, second_space - first_space - 1);
+    size_t question = target.find('?');
+    request.path = target.substr(0, question);
+    request.query = question == string::npos ? "" : target.substr(question + 1);
+
+    //из заголовков нужна только длина тела
+    size_t length = 0;
+    for (size_t pos = line_end + 2; pos < end; ) {
+        size_t next = head.find("\r\n", pos);
+        string header = head.substr(pos, next - pos);
+        for (size_t i = 0; i < header.size() && header[i] != ':'; i++) header[i] = (char)tolower((unsigned char)header[i]);
+        if (header.compare(0, 15, "content-length:") == 0) length = strtoull(header.c_str() + 15, NULL, 10);
+        pos = next + 2;
+    }
+    if (length > MAX_BODY) return 413;
+    if (length == 0) return 0;
+
+    request.body.create(1, (int)length, CV_8U);
+    size_t have = min(head.size() - (end + 4), length);
+    memcpy(request.body.data, head.data() + end + 4, have);
+    while (have < length) {
+        ssize_t got = recv(fd, request.body.data + have, length - have, 0);
+        if (got <= 0) return 400;
+        have += got;
+    }
+    return 0;
+}
+
+/*!
+Значение параметра из строки запроса
+*/
+static string QueryValue(const string& query, const string& key)
+{
+    for (size_t pos = 0; pos <= query.size(); ) {
+        size_t next = query.find('&', pos);
+        if (next == string::npos) next = query.size();
+        if (query.compare(pos, key.size() + 1, key + "=") == 0) return query.substr(pos + key.size() + 1, next - pos - key.size() - 1);
+        pos = next + 1;
+    }
+    return "";
+}
+
+/*!
+HTTP-код для результата операции движка: ошибки во входных данных - 400, остальное - 500
+*/
+static int HttpCode(SolverStatus status)
+{
+    return status == SOLVER_DECODE_FAILED || status == SOLVER_BAD_CORNERS || status == SOLVER_EMPTY_PATH ? 400 : 500;
+}
+
+/*!
+Обслуживает одно соединение
+*/
+static void Serve(int fd, const PerspectiveSolver& solver, const SaveOptions& encoding)
+{
+    HttpRequest request;
+    int error = ReadRequest(fd, request);
+    if (error != 0) {
+        RespondError(fd, error, error == 413 ? "Payload Too Large" : "Bad Request", "Malformed or too large request");
+        return;
+    }
+    if (request.path != "/rectify") {
+        RespondError(fd, 404, "Not Found", "Use POST /rectify?corners=x1,y1,x2,y2,x3,y3,x4,y4");
+        return;
+    }
+    if (request.method != "POST") {
+        RespondError(fd, 405, "Method Not Allowed", "Use POST with the image in the body");
+        return;
+    }
+
+    Point2f corners[4];
+    if (sscanf(QueryValue(request.query, "corners").c_str(), "%f,%f,%f,%f,%f,%f,%f,%f",
+        &corners[0].x, &corners[0].y, &corners[1].x, &corners[1].y, &corners[2].x, &corners[2].y, &corners[3].x, &corners[3].y) != 8) {
+        RespondError(fd, 400, "Bad Request", "Expected corners=x1,y1,x2,y2,x3,y3,x4,y4");
+        return;
+    }
+    //%f принимает и nan, inf, 1e30: такие углы отклоняют Plan и DecodeRegion, ответ - 400
+
+    //format - имя формата или полное описание кодировщика, например png:level=9 или jpeg:quality=80,progressive
+    SaveOptions options = encoding;
+    string format = QueryValue(request.query, "format");
+    if (!format.empty() && (!ParseSaveOptions(format, options) || !EncoderAvailable(options.format))) {
+        RespondError(fd, 400, "Bad Request", "Unknown or unavailable format");
+        return;
+    }
+
+    //геометрию можно переопределить для одного запроса, движок при этом не меняется
+    OutputGeometry geometry = solver.Geometry();
+    string size = QueryValue(request.query, "size");
+    if (!size.empty() && !ParseOutputGeometry(size, geometry)) {
+        RespondError(fd, 400, "Bad Request", "Expected size=WxH|quad|a4|letter");
+        return;
+    }
+    string dpi = QueryValue(request.query, "dpi");
+    if (!dpi.empty()) {
+        char* end = NULL;
+        long value = strtol(dpi.c_str(), &end, 10);
+        if (*end != 0 || value < 0 || value > MAX_REQUEST_DPI) {
+            RespondError(fd, 400, "Bad Request", "Expected dpi=0.." + to_string(MAX_REQUEST_DPI));
+            return;
+        }
+        geometry.dpi = (int)value;
+    }
+    PerspectiveSolver request_solver(geometry, solver.Backend(), solver.Layout());
+
+    //декодируем только часть изображения вокруг углов, матрица сдвигается под нее
+    Mat image, result;
+    Point origin;
+    WarpPlan plan;
+    vector<uchar> encoded;
+    SolverStatus status = request_solver.Plan(corners, plan);
+    if (status == SOLVER_OK && (long long)plan.size.width * plan.size.height > MAX_REQUEST_PIXELS) {
+        //size=WxH, quad и a4 без dpi могут дать результат до MAX_OUTPUT_SIDE по стороне - сотни мегабайт на поток
+        RespondError(fd, 400, "Bad Request", "Output larger than " + to_string(MAX_REQUEST_PIXELS) + " pixels, lower size or dpi");
+        return;
+    }
+    if (status == SOLVER_OK) status = request_solver.DecodeRegion(request.body, corners, image, origin);
+    if (status == SOLVER_OK) status = request_solver.Warp(image, OffsetPlan(plan, origin), result);
+    if (status == SOLVER_OK) status = EncodeImage(result, options, encoded);
+    if (status != SOLVER_OK) {
+        RespondError(fd, HttpCode(status), HttpCode(status) == 400 ? "Bad Request" : "Internal Server Error", SolverStatusText(status));
+        return;
+    }
+
+    Respond(fd, 200, "OK", SaveFormatMime(options.format), encoded.data(), encoded.size());
+}
+
+int RunServer(const char* address, const PerspectiveSolver& solver, int threads, size_t depth, const SaveOptions& encoding)
+{
+    string where(address);
+    bool unix_socket = where.compare(0, 5, "unix:") == 0;
+    string socket_path = unix_socket ? where.substr(5) : "";
+
+    int listener = -1;
+    if (unix_socket) {
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        if (socket_path.empty() || socket_path.size() >= sizeof(local.sun_path)) {
+            cerr << "Bad socket path " << socket_path << endl;
+            return 1;
+        }
+        strcpy(local.sun_path, socket_path.c_str());
+        unlink(socket_path.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener >= 0 && bind(listener, (sockaddr*)&local, sizeof(local)) < 0) {
+            close(listener);
+            listener = -1;
+        }
+    }
+    else {
+        //только петлевой интерфейс: сервис не предназначен для сети
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons((uint16_t)atoi(where.c_str()));
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listener >= 0) setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listener >= 0 && bind(listener, (sockaddr*)&local, sizeof(local)) < 0) {
+            close(listener);
+            listener = -1;
+        }
+    }
+    if (listener < 0 || listen(listener, 128) < 0) {
+        cerr << "Failed to listen on " << where << endl;
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+
+    if (threads <= 0) threads = (int)thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    //параллелим по запросам, как в пакетном режиме
+    setNumThreads(1);
+
+    //клиент, закрывший соединение раньше времени, не должен убивать процесс
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, OnStopSignal);
+    signal(SIGTERM, OnStopSignal);
+
+    BoundedQueue<int> connections(depth);
+    atomic<int> served(0);
+
+    auto worker = [&]() {
+        int fd;
+        while (connections.Pop(fd)) {
+            Serve(fd, solver, encoding);
+            close(fd);
+            served++;
+        }
+    };
+
+    vector<thread> pool;
+    for (int i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+
+    cout << "Listening on " << (unix_socket ? where : "127.0.0.1:" + where) << " with " << threads << " threads, Ctrl+C to stop" << endl;
+
+    while (!stop_requested) {
+        pollfd descriptor = { listener, POLLIN, 0 };
+        if (poll(&descriptor, 1, 500) <= 0) continue; //таймаут или сигнал: проверяем флаг остановки
+
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+
+        //медленный клиент не должен навсегда занимать рабочий поток
+        timeval timeout = { IO_TIMEOUT, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        //если все потоки заняты и очередь полна, ждем здесь, а новые соединения ждут в очереди ядра
+        connections.Push(fd);
+    }
+
+    //отвечаем на уже принятые соединения
+    connections.Close();
+    for (thread& t : pool) {
+        t.join();
+    }
+    close(listener);
+    if (unix_socket) unlink(socket_path.c_str());
+
+    cout << served << " requests served" << endl;
+    return 0;
+}
+
+#else
+
+int RunServer(const char* address, const PerspectiveSolver& solver, int threads, size_t depth, const SaveOptions& encoding)
+{
+    cerr << "HTTP service is available only on Linux and Mac OS X" << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include "encoders.h"
+#include "solver.h"
+
+/*!
+Локальный HTTP-сервис исправления перспективы.
+Слушает только 127.0.0.1 или Unix-сокет и отвечает на запросы вида
+"POST /rectify?corners=x1,y1,x2,y2,x3,y3,x4,y4[&format=jpg|png|webp][&size=WxH|quad|a4|letter][&dpi=N]"
+с файлом изображения в теле: в ответ приходит исправленное изображение.
+Принятые соединения ставятся в общую очередь, которую разбирает пул потоков, поэтому
+много мелких одновременных запросов не порождают по потоку на соединение. Каждое соединение обслуживает один запрос.
+Работает до SIGINT/SIGTERM. Доступно в Linux и Mac OS X.
+\param[in] address Порт на 127.0.0.1 ("8080") или путь Unix-сокета ("unix:/tmp/solver.sock")
+\param[in] solver Движок с выбранными ядром и геометрией результата по умолчанию
+\param[in] threads Количество рабочих потоков, 0 - по числу ядер
+\param[in] depth Сколько принятых соединений может ждать свободного потока
+\param[in] encoding Формат и настройки ответа по умолчанию, параметр format запроса меняет их поверх
+\returns код возврата процесса
+*/
+int RunServer(const char* address, const PerspectiveSolver& solver, int threads = 0, size_t depth = 64, const SaveOptions& encoding = SaveOptions());
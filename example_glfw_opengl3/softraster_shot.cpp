@@ -0,0 +1,131 @@
+// Проверка imgui_impl_softraster без окна и OpenGL: рисует кадр интерфейса в буфер и проверяет пиксели.
+// Запуск: softraster_shot [снимок.ppm или ""] [потоки]. Код возврата 0, если все проверки прошли, иначе 1.
+
+#include "imgui.h"
+#include "imgui_impl_softraster.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+const int SHOT_WIDTH = 640;
+const int SHOT_HEIGHT = 480;
+const unsigned char CLEAR_COLOR[4] = { 20, 40, 60, 255 };
+
+/*!
+Рисует один кадр: окно с текстом и красной кнопкой, и сетку мелких прямоугольников на фоне,
+чтобы треугольников хватило для рисования в нескольких потоках
+\param[out] pixels RGBA буфер SHOT_WIDTH x SHOT_HEIGHT
+\param[out] swatch прямоугольник красной кнопки
+\param[out] text прямоугольник строки текста
+*/
+static void RenderFrame(vector<unsigned char>& pixels, ImVec4& swatch, ImVec4& text)
+{
+    ImGui_ImplSoftRaster_NewFrame();
+    ImGui::NewFrame();
+
+    ImDrawList* background = ImGui::GetBackgroundDrawList();
+    for (int y = 300; y < SHOT_HEIGHT; y += 6) {
+        for (int x = 0; x < SHOT_WIDTH; x += 6) {
+            background->AddRectFilled(ImVec2((float)x, (float)y), ImVec2(x + 4.0f, y + 4.0f), IM_COL32(x % 256, y % 256, 128, 160));
+        }
+    }
+
+    ImGui::SetNextWindowPos(ImVec2(40, 30), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiCond_Always);
+    ImGui::Begin("softraster", NULL, ImGuiWindowFlags_NoCollapse);
+    ImGui::Text("Perspective solver");
+    text = ImVec4(ImGui::GetItemRectMin().x, ImGui::GetItemRectMin().y, ImGui::GetItemRectMax().x, ImGui::GetItemRectMax().y);
+    ImGui::ColorButton("red", ImVec4(1, 0, 0, 1), ImGuiColorEditFlags_NoTooltip, ImVec2(60, 40));
+    swatch = ImVec4(ImGui::GetItemRectMin().x, ImGui::GetItemRectMin().y, ImGui::GetItemRectMax().x, ImGui::GetItemRectMax().y);
+    ImGui::End();
+
+    ImGui::Render();
+
+    pixels.resize(SHOT_WIDTH * SHOT_HEIGHT * 4);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        memcpy(&pixels[i], CLEAR_COLOR, 4);
+    }
+    ImGui_ImplSoftRaster_RenderDrawData(ImGui::GetDrawData(), pixels.data(), SHOT_WIDTH, SHOT_HEIGHT, SHOT_WIDTH * 4);
+}
+
+/*!
+Рисует кадр в заданном числе потоков. Первый кадр ImGui только раскладывает окна, проверяется второй
+*/
+static void Shot(int threads, vector<unsigned char>& pixels, ImVec4& swatch, ImVec4& text)
+{
+    ImGui_ImplSoftRaster_Init(threads);
+    for (int frame = 0; frame < 2; frame++) {
+        RenderFrame(pixels, swatch, text);
+    }
+    ImGui_ImplSoftRaster_Shutdown();
+}
+
+static const unsigned char* Pixel(const vector<unsigned char>& pixels, float x, float y)
+{
+    return &pixels[((int)y * SHOT_WIDTH + (int)x) * 4];
+}
+
+static bool Check(bool passed, const char* what)
+{
+    printf("%s %s\n", passed ? "ok  " : "FAIL", what);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 && argv[1][0] ? argv[1] : NULL;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.DisplaySize = ImVec2((float)SHOT_WIDTH, (float)SHOT_HEIGHT);
+    io.DeltaTime = 1.0f / 60.0f;
+    ImGui::StyleColorsDark();
+
+    vector<unsigned char> single, parallel;
+    ImVec4 swatch, text;
+    Shot(1, single, swatch, text);
+    Shot(threads, parallel, swatch, text);
+
+    bool passed = true;
+    const unsigned char* corner = Pixel(single, SHOT_WIDTH - 1, 0);
+    passed &= Check(memcmp(corner, CLEAR_COLOR, 4) == 0, "background outside the window keeps the clear color");
+
+    const unsigned char red[4] = { 255, 0, 0, 255 };
+    const unsigned char* center = Pixel(single, (swatch.x + swatch.z) / 2, (swatch.y + swatch.w) / 2);
+    passed &= Check(memcmp(center, red, 4) == 0, "opaque color button is filled exactly");
+
+    const unsigned char* inside = Pixel(single, 330, 220);
+    passed &= Check(memcmp(inside, CLEAR_COLOR, 4) != 0, "window background is blended over the clear color");
+
+    int bright = 0;
+    for (int y = (int)text.y; y < (int)text.w; y++) {
+        for (int x = (int)text.x; x < (int)text.z; x++) {
+            if (Pixel(single, (float)x, (float)y)[0] > 200) bright++;
+        }
+    }
+    passed &= Check(bright > 50, "text is drawn from the font atlas");
+
+    passed &= Check(single == parallel, "worker threads render the same pixels as one thread");
+
+    if (path) {
+        FILE* file = fopen(path, "wb");
+        if (file) {
+            fprintf(file, "P6\n%d %d\n255\n", SHOT_WIDTH, SHOT_HEIGHT);
+            for (size_t i = 0; i < single.size(); i += 4) {
+                fwrite(&single[i], 1, 3, file);
+            }
+            fclose(file);
+        }
+        passed &= Check(file != NULL, "screenshot is written");
+    }
+
+    ImGui::DestroyContext();
+    return passed ? 0 : 1;
+}
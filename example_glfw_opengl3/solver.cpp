@@ -0,0 +1,476 @@
+#include "solver.h"
+#include "profiler.h"
+#include "mapped_file.h"
+#include "region_decode.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+void SortPoints(Point2f points[])//сортировка выбранных точек, в порядок, который нужен opencv
+{
+
+    Point2f tmp(0,0);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 3; j >= (i + 1); j--) {
+            if (points[j].y < points[j - 1].y) {
+                tmp = points[j];
+                points[j] = points[j - 1];
+                points[j - 1] = tmp;
+            }
+        }
+    }
+   
+    if (points[0].x > points[1].x) {
+        tmp = points[1];
+        points[1] = points[0];
+        points[0] = tmp;
+    }
+
+    if (points[2].x > points[3].x) {
+        tmp = points[3];
+        points[3] = points[2];
+        points[2] = tmp;
+    }
+
+
+}
+
+Size2f QuadSize(const Point2f points[4])
+{
+    float top = (float)norm(points[1] - points[0]);
+    float bottom = (float)norm(points[3] - points[2]);
+    float left = (float)norm(points[2] - points[0]);
+    float right = (float)norm(points[3] - points[1]);
+    return Size2f(max(top, bottom), max(left, right));
+}
+
+Size ComputeOutputSize(const Point2f corners[4], const OutputGeometry& geometry)
+{
+    double w = geometry.size.width;
+    double h = geometry.size.height;
+
+    if (geometry.mode != OUTPUT_FIXED) {
+        Point2f points[4] = { corners[0], corners[1], corners[2], corners[3] };
+        SortPoints(points);
+        Size2f quad = QuadSize(points);
+        w = quad.width;
+        h = quad.height;
+
+        if (geometry.mode == OUTPUT_PAPER) {
+            //стороны листа в миллиметрах, ориентацию берем у четырехугольника
+            double shorter = geometry.paper == PAPER_LETTER ? 215.9 : 210.0;
+            double longer = geometry.paper == PAPER_LETTER ? 279.4 : 297.0;
+            double long_side = geometry.dpi > 0 ? longer / 25.4 * geometry.dpi : max(w, h);
+            double short_side = long_side * shorter / longer;
+            if (w > h) { w = long_side; h = short_side; }
+            else { w = short_side; h = long_side; }
+        }
+    }
+
+    int width = min(max((int)lround(w), 1), MAX_OUTPUT_SIDE);
+    int height = min(max((int)lround(h), 1), MAX_OUTPUT_SIDE);
+    return Size(width, height);
+}
+
+bool ParseOutputGeometry(const string& text, OutputGeometry& geometry)
+{
+    if (text == "quad") geometry.mode = OUTPUT_QUAD;
+    else if (text == "a4") { geometry.mode = OUTPUT_PAPER; geometry.paper = PAPER_A4; }
+    else if (text == "letter") { geometry.mode = OUTPUT_PAPER; geometry.paper = PAPER_LETTER; }
+    else {
+        int w = 0, h = 0;
+        char x = 0, rest = 0;
+        if (sscanf(text.c_str(), "%d%c%d%c", &w, &x, &h, &rest) != 3 || x != 'x') return false;
+        if (w <= 0 || h <= 0 || w > MAX_OUTPUT_SIDE || h > MAX_OUTPUT_SIDE) return false;
+        geometry.mode = OUTPUT_FIXED;
+        geometry.size = Size(w, h);
+    }
+    return true;
+}
+
+const char* SolverStatusText(SolverStatus status)
+{
+    switch (status) {
+    case SOLVER_OK: return "Ok";
+    case SOLVER_EMPTY_PATH: return "Empty path to image";
+    case SOLVER_DECODE_FAILED: return "Empty image. Failed to open.";
+    case SOLVER_BAD_CORNERS: return "Corners do not form a quadrangle";
+    case SOLVER_WARP_FAILED: return "Failed to solve perspective";
+    case SOLVER_EMPTY_RESULT: return "Nothing to save yet";
+    case SOLVER_SAVE_FAILED: return "Something went wrong while saving :(";
+    case SOLVER_QUEUE_FULL: return "Too many images are waiting to be saved";
+    }
+    return "Unknown error";
+}
+
+PerspectiveSolver::PerspectiveSolver(const OutputGeometry& geometry, WarpBackend backend, WarpLayout layout) : geometry(geometry), backend(backend), layout(layout)
+{
+}
+
+SolverStatus PerspectiveSolver::Load(const string& path, Mat& image) const
+{
+    SOLVER_PROFILE_SCOPE("load");
+    if (path.empty()) return SOLVER_EMPTY_PATH;
+
+    //декодируем прямо из отображения файла в память, без чтения в промежуточный буфер
+    MappedFile file;
+    if (file.Open(path) && Decode(file.Bytes(), image) == SOLVER_OK) return SOLVER_OK;
+
+    //не отобразился (например, не обычный файл) - пусть OpenCV читает сам
+    try
+    {
+        image = imread(path);
+    }
+    catch (const std::exception&)
+    {
+        image.release();
+    }
+    return image.empty() ? SOLVER_DECODE_FAILED : SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Decode(const Mat& bytes, Mat& image) const
+{
+    SOLVER_PROFILE_SCOPE("decode");
+    if (bytes.empty()) return SOLVER_DECODE_FAILED;
+
+    try
+    {
+        image = imdecode(bytes, IMREAD_COLOR);
+    }
+    catch (const std::exception&)
+    {
+        image.release();
+    }
+    return image.empty() ? SOLVER_DECODE_FAILED : SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::LoadRegion(const string& path, const Point2f corners[4], Mat& image, Point& origin) const
+{
+    SOLVER_PROFILE_SCOPE("load");
+    if (path.empty()) return SOLVER_EMPTY_PATH;
+
+    MappedFile file;
+    if (file.Open(path)) return DecodeRegion(file.Bytes(), corners, image, origin);
+
+    //не отобразился - читаем целиком и обрезаем
+    SolverStatus status = Load(path, image);
+    if (status != SOLVER_OK) return status;
+
+    Rect region = QuadRegion(corners, image.size(), REGION_MARGIN);
+    if (region.empty()) return SOLVER_BAD_CORNERS;
+    image = image(region);
+    origin = region.tl();
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::DecodeRegion(const Mat& bytes, const Point2f corners[4], Mat& image, Point& origin) const
+{
+    SOLVER_PROFILE_SCOPE("decode_region");
+    if (bytes.empty()) return SOLVER_DECODE_FAILED;
+
+    try
+    {
+        if (DecodeJpegRegion(bytes, corners, REGION_MARGIN, image, origin)) return SOLVER_OK;
+        if (DecodeTiffRegion(bytes, corners, REGION_MARGIN, image, origin)) return SOLVER_OK;
+    }
+    catch (const std::exception&)
+    {
+        image.release();
+    }
+
+    //остальные форматы декодируем целиком, но исправляем только из нужной части
+    SolverStatus status = Decode(bytes, image);
+    if (status != SOLVER_OK) return status;
+
+    Rect region = QuadRegion(corners, image.size(), REGION_MARGIN);
+    if (region.empty()) return SOLVER_BAD_CORNERS;
+    image = image(region);
+    origin = region.tl();
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Warp(const Mat& source, const Point2f corners[4], Mat& result, Size size, WarpLayout layout) const
+{
+    WarpPlan plan;
+    SolverStatus status = Plan(corners, plan, size);
+    if (status != SOLVER_OK) return status;
+
+    return Warp(source, plan, result, layout);
+}
+
+SolverStatus PerspectiveSolver::Plan(const Point2f corners[4], WarpPlan& plan, Size size) const
+{
+    SOLVER_PROFILE_SCOPE("plan");
+
+    //nan из манифеста, файла углов или запроса проходит проверку площади ниже (сравнение с nan ложно), поэтому ловим его здесь
+    for (int i = 0; i < 4; i++) {
+        if (!isfinite(corners[i].x) || !isfinite(corners[i].y)) return SOLVER_BAD_CORNERS;
+    }
+    if (size.width <= 0 || size.height <= 0) size = OutputSize(corners);
+
+    //сортируем копию, чтобы не менять углы вызывающего
+    Point2f points[4] = { corners[0], corners[1], corners[2], corners[3] };
+    SortPoints(points);
+
+    //у вырожденного четырехугольника не существует матрицы исправления
+    Point2f contour[4] = { points[0], points[1], points[3], points[2] };
+    if (contourArea(vector<Point2f>(contour, contour + 4)) < 1) return SOLVER_BAD_CORNERS;
+
+    float w = (float)size.width;
+    float h = (float)size.height;
+    Point2f border[4] = { Point2f(0, 0), Point2f(w, 0), Point2f(0, h), Point2f(w, h) }; //рамка для исправления
+
+    try
+    {
+        plan.transform = Matx33d(getPerspectiveTransform(points, border));
+        plan.size = size;
+    }
+    catch (const std::exception&)
+    {
+        return SOLVER_BAD_CORNERS;
+    }
+    return SOLVER_OK;
+}
+
+WarpPlan OffsetPlan(const WarpPlan& plan, Point origin)
+{
+    //точка части изображения (x, y) - это точка (x + origin.x, y + origin.y) полного
+    Matx33d shift(1, 0, (double)origin.x, 0, 1, (double)origin.y, 0, 0, 1);
+    WarpPlan offset;
+    offset.transform = plan.transform * shift;
+    offset.size = plan.size;
+    return offset;
+}
+
+SolverStatus PerspectiveSolver::Warp(const Mat& source, const WarpPlan& plan, Mat& result, WarpLayout layout) const
+{
+    SOLVER_PROFILE_SCOPE("warp");
+    try
+    {
+        //собственное ядро пишет сразу в нужном виде, cv::warpPerspective - в виде источника с переводом отдельным проходом
+        if (backend == WARP_SIMD) WarpPerspectiveBilinear(source, result, plan.transform, plan.size, layout);
+        else if (layout == WARP_LAYOUT_SOURCE) warpPerspective(source, result, Mat(plan.transform), plan.size);
+        else {
+            Mat warped;
+            warpPerspective(source, warped, Mat(plan.transform), plan.size);
+            ConvertToLayout(warped, result, layout);
+        }
+    }
+    catch (const std::exception&)
+    {
+        result.release();
+        return SOLVER_WARP_FAILED;
+    }
+    return SOLVER_OK;
+}
+
+/*!
+Дисторсия нормированной точки по модели OpenCV
+*/
+static Point2d DistortNormalized(const double* k, double x, double y)
+{
+    double r2 = x * x + y * y;
+    double radial = (1 + ((k[4] * r2 + k[1]) * r2 + k[0]) * r2) / (1 + ((k[7] * r2 + k[6]) * r2 + k[5]) * r2);
+    return Point2d(x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x),
+        y * radial + k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y);
+}
+
+Point2d DistortPoint(const CameraModel& camera, Point2d point)
+{
+    if (camera.Empty()) return point;
+    Point2d distorted = DistortNormalized(camera.distortion, (point.x - camera.cx) / camera.fx, (point.y - camera.cy) / camera.fy);
+    return Point2d(distorted.x * camera.fx + camera.cx, distorted.y * camera.fy + camera.cy);
+}
+
+Point2d UndistortPoint(const CameraModel& camera, Point2d point)
+{
+    if (camera.Empty()) return point;
+    const double* k = camera.distortion;
+    double x0 = (point.x - camera.cx) / camera.fx;
+    double y0 = (point.y - camera.cy) / camera.fy;
+
+    //неподвижная точка x = (x0 - тангенциальная часть) / радиальная, как в cv::undistortPoints
+    double x = x0, y = y0;
+    for (int i = 0; i < 20; i++) {
+        double r2 = x * x + y * y;
+        double inverse = (1 + ((k[7] * r2 + k[6]) * r2 + k[5]) * r2) / (1 + ((k[4] * r2 + k[1]) * r2 + k[0]) * r2);
+        double delta_x = 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x);
+        double delta_y = k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y;
+        x = (x0 - delta_x) * inverse;
+        y = (y0 - delta_y) * inverse;
+    }
+    return Point2d(x * camera.fx + camera.cx, y * camera.fy + camera.cy);
+}
+
+void UndistortCorners(const CameraModel& camera, const Point2f corners[4], Point2f undistorted[4])
+{
+    for (int i = 0; i < 4; i++) {
+        Point2d point = UndistortPoint(camera, Point2d(corners[i].x, corners[i].y));
+        undistorted[i] = Point2f((float)point.x, (float)point.y);
+    }
+}
+
+SolverStatus PerspectiveSolver::BuildRemap(const Point2f corners[4], const CameraModel& camera, int interpolation, RemapTable& table, Size size) const
+{
+    //углы отмечены на снимке с дисторсией, матрица считается по тем же углам без нее
+    Point2f undistorted[4];
+    UndistortCorners(camera, corners, undistorted);
+
+    WarpPlan plan;
+    SolverStatus status = Plan(undistorted, plan, size);
+    if (status != SOLVER_OK) return status;
+    return BuildRemap(plan, interpolation, table, camera);
+}
+
+static const double REMAP_OUTSIDE = -16; //!<точка источника для пикселя без прообраза: дальше окрестности INTER_LANCZOS4, BORDER_CONSTANT дает черный
+
+SolverStatus PerspectiveSolver::BuildRemap(const WarpPlan& plan, int interpolation, RemapTable& table, const CameraModel& camera) const
+{
+    SOLVER_PROFILE_SCOPE("build_remap");
+    if (plan.size.width <= 0 || plan.size.height <= 0) return SOLVER_BAD_CORNERS;
+
+    //таблица хранит для пикселя результата точку источника, поэтому нужна обратная матрица
+    bool invertible = false;
+    Matx33d inverse = plan.transform.inv(DECOMP_LU, &invertible);
+    if (!invertible) return SOLVER_BAD_CORNERS;
+
+    Mat map_x(plan.size, CV_32F), map_y(plan.size, CV_32F);
+    float extent = 0; //!<наибольшая по модулю координата источника
+    for (int y = 0; y < plan.size.height; y++) {
+        float* row_x = map_x.ptr<float>(y);
+        float* row_y = map_y.ptr<float>(y);
+        for (int x = 0; x < plan.size.width; x++) {
+            double w = inverse(2, 0) * x + inverse(2, 1) * y + inverse(2, 2);
+            Point2d source(REMAP_OUTSIDE, REMAP_OUTSIDE);
+            if (w != 0) {
+                w = 1 / w;
+                source = Point2d((inverse(0, 0) * x + inverse(0, 1) * y + inverse(0, 2)) * w, (inverse(1, 0) * x + inverse(1, 1) * y + inverse(1, 2)) * w);
+
+                //точка изображения без дисторсии переводится в точку снимка, оба пересчета попадают в одну таблицу
+                if (!camera.Empty()) source = DistortPoint(camera, source);
+            }
+            row_x[x] = (float)source.x;
+            row_y[x] = (float)source.y;
+            extent = max(extent, max(fabs(row_x[x]), fabs(row_y[x])));
+        }
+    }
+
+    table.interpolation = interpolation;
+    try
+    {
+        //фиксированная точка вдвое быстрее в cv::remap, но ограничена 16 битами на координату
+        if (extent < SHRT_MAX - 1) convertMaps(map_x, map_y, table.map1, table.map2, CV_16SC2, interpolation == INTER_NEAREST);
+        else {
+            merge(vector<Mat>{ map_x, map_y }, table.map1);
+            table.map2.release();
+        }
+    }
+    catch (const std::exception&)
+    {
+        return SOLVER_BAD_CORNERS;
+    }
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Warp(const Mat& source, const RemapTable& table, Mat& result, WarpLayout layout) const
+{
+    SOLVER_PROFILE_SCOPE("remap");
+    try
+    {
+        if (layout == WARP_LAYOUT_SOURCE) remap(source, result, table.map1, table.map2, table.interpolation);
+        else {
+            Mat remapped;
+            remap(source, remapped, table.map1, table.map2, table.interpolation);
+            ConvertToLayout(remapped, result, layout);
+        }
+    }
+    catch (const std::exception&)
+    {
+        result.release();
+        return SOLVER_WARP_FAILED;
+    }
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Save(const string& path, const Mat& result, const vector<int>& params) const
+{
+    SOLVER_PROFILE_SCOPE("save");
+    if (result.empty()) return SOLVER_EMPTY_RESULT;
+
+    try
+    {
+        if (!imwrite(path, result, params)) return SOLVER_SAVE_FAILED;
+    }
+    catch (const std::exception&)
+    {
+        return SOLVER_SAVE_FAILED;
+    }
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Encode(const string& extension, const Mat& result, vector<uchar>& bytes, const vector<int>& params) const
+{
+    SOLVER_PROFILE_SCOPE("encode");
+    if (result.empty()) return SOLVER_EMPTY_RESULT;
+
+    try
+    {
+        if (!imencode(extension, result, bytes, params)) return SOLVER_SAVE_FAILED;
+    }
+    catch (const std::exception&)
+    {
+        return SOLVER_SAVE_FAILED;
+    }
+    return SOLVER_OK;
+}
+
+SolverStatus PerspectiveSolver::Rectify(const string& input, const Point2f corners[4], Mat& result) const
+{
+    Mat image;
+    Point origin;
+
+    //матрица считается по углам полного изображения и сдвигается под декодированную часть
+    WarpPlan plan;
+    SolverStatus status = Plan(corners, plan);
+    if (status != SOLVER_OK) return status;
+
+    status = LoadRegion(input, corners, image, origin);
+    if (status != SOLVER_OK) return status;
+
+    return Warp(image, OffsetPlan(plan, origin), result, layout);
+}
+
+SolverStatus PerspectiveSolver::Rectify(const string& input, const Point2f corners[4], const string& output) const
+{
+    Mat result;
+    SolverStatus status = Rectify(input, corners, result);
+    if (status != SOLVER_OK) return status;
+
+    return Save(output, result);
+}
+
+SolverStatus PerspectiveSolver::Rectify(const string& input, const RemapTable& table, Mat& result) const
+{
+    Mat image;
+
+    SolverStatus status = Load(input, image);
+    if (status != SOLVER_OK) return status;
+
+    return Warp(image, table, result, layout);
+}
+
+SolverStatus PerspectiveSolver::Rectify(const string& input, const RemapTable& table, const string& output) const
+{
+    Mat result;
+    SolverStatus status = Rectify(input, table, result);
+    if (status != SOLVER_OK) return status;
+
+    return Save(output, result);
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "warp.h"
+
+/*!
+Сортирует точки, отмеченные на изображении в соответствии требованиям OpenCV(Левый верхний, правый верхний, нижний левый, нижний правый)
+\param points Массив точек
+*/
+void SortPoints(cv::Point2f points[]);
+
+/*!
+Как выбирать размер исправленного изображения
+*/
+enum OutputMode
+{
+    OUTPUT_FIXED = 0, //!<всегда один и тот же размер
+    OUTPUT_QUAD, //!<ширина и высота по длинам сторон отмеченного четырехугольника
+    OUTPUT_PAPER //!<пропорции листа бумаги, разрешение по четырехугольнику или по DPI
+};
+
+/*!
+Форматы листа для OUTPUT_PAPER
+*/
+enum PaperFormat
+{
+    PAPER_A4 = 0, //!<210x297 мм
+    PAPER_LETTER //!<8.5x11 дюймов
+};
+
+/*!
+Геометрия исправленного изображения
+*/
+struct OutputGeometry
+{
+    OutputMode mode = OUTPUT_FIXED; //!<как выбирать размер
+    cv::Size size = cv::Size(500, 500); //!<размер для OUTPUT_FIXED
+    PaperFormat paper = PAPER_A4; //!<формат листа для OUTPUT_PAPER
+    int dpi = 0; //!<разрешение листа для OUTPUT_PAPER, 0 - длинная сторона берется из четырехугольника
+};
+
+/*!
+Считает размеры четырехугольника
+\param[in] points Углы в порядке SortPoints
+\returns Ширина - длинная из верхней и нижней сторон, высота - длинная из левой и правой
+*/
+cv::Size2f QuadSize(const cv::Point2f points[4]);
+
+/*!
+Считает размер исправленного изображения для отмеченных углов
+\param[in] corners Углы документа в любом порядке
+\param[in] geometry Как выбирать размер
+\returns Размер исправленного изображения, не меньше 1x1 и не больше MAX_OUTPUT_SIDE по каждой стороне
+*/
+cv::Size ComputeOutputSize(const cv::Point2f corners[4], const OutputGeometry& geometry);
+
+/*!
+Разбирает геометрию из командной строки: "WxH", "quad", "a4" или "letter"
+\param[in] text Строка с описанием
+\param[out] geometry Куда записать режим, DPI не меняется
+\returns true если строка распознана
+*/
+bool ParseOutputGeometry(const std::string& text, OutputGeometry& geometry);
+
+const int MAX_OUTPUT_SIDE = 16384; //!<ограничение стороны результата, чтобы промах мышью или DPI не съели всю память
+const int MAX_DPI = 1200; //!<ограничение OutputGeometry::dpi в окне и ключах запуска
+
+/*!
+Результат операции движка исправления перспективы
+*/
+enum SolverStatus
+{
+    SOLVER_OK = 0, //!<операция выполнена
+    SOLVER_EMPTY_PATH, //!<пустой путь до изображения
+    SOLVER_DECODE_FAILED, //!<изображение не открылось
+    SOLVER_BAD_CORNERS, //!<углы не образуют четырехугольник
+    SOLVER_WARP_FAILED, //!<OpenCV не смог исправить перспективу
+    SOLVER_EMPTY_RESULT, //!<нечего сохранять
+    SOLVER_SAVE_FAILED, //!<изображение не сохранилось
+    SOLVER_QUEUE_FULL //!<слишком много изображений ждут сохранения
+};
+
+/*!
+Возвращает текстовое описание результата операции
+\param[in] status Результат операции
+\returns Описание для показа пользователю
+*/
+const char* SolverStatusText(SolverStatus status);
+
+/*!
+Готовое преобразование для одного набора углов.
+Матрица считается один раз и затем применяется к любому числу изображений того же размера,
+например ко всем кадрам видео со статичной камеры.
+*/
+struct WarpPlan
+{
+    cv::Matx33d transform; //!<переводит координаты исходного изображения в координаты результата
+    cv::Size size; //!<размер результата
+};
+
+/*!
+Сдвигает матрицу исправления под часть изображения
+\param[in] plan Матрица для полного изображения
+\param[in] origin Где на полном изображении лежит левый верхний пиксель части
+\returns Матрица, которая дает тот же результат из части изображения
+*/
+WarpPlan OffsetPlan(const WarpPlan& plan, cv::Point origin);
+
+/*!
+Модель камеры для снятия дисторсии объектива, как у cv::calibrateCamera: внутренние параметры и коэффициенты
+k1 k2 p1 p2 k3 k4 k5 k6 (радиальные, тангенциальные и рациональные). Перекос пикселя не учитывается.
+Углы документа при этом отмечаются на исходном, искаженном снимке
+*/
+struct CameraModel
+{
+    double fx = 0, fy = 0; //!<фокусное расстояние в пикселях, 0 - модели нет
+    double cx = 0, cy = 0; //!<главная точка
+    double distortion[8] = {}; //!<k1 k2 p1 p2 k3 k4 k5 k6, недостающие коэффициенты нулевые
+
+    bool Empty() const { return fx == 0 || fy == 0; }
+};
+
+/*!
+Переводит точку идеального изображения без дисторсии в точку снимка
+\param[in] camera Модель камеры, пустая модель возвращает точку как есть
+\param[in] point Точка в пикселях изображения без дисторсии с теми же fx, fy, cx, cy
+\returns Точка на снимке
+*/
+cv::Point2d DistortPoint(const CameraModel& camera, cv::Point2d point);
+
+/*!
+Обратная к DistortPoint: находит точку без дисторсии итерациями, как cv::undistortPoints
+\param[in] camera Модель камеры, пустая модель возвращает точку как есть
+\param[in] point Точка на снимке
+\returns Точка изображения без дисторсии
+*/
+cv::Point2d UndistortPoint(const CameraModel& camera, cv::Point2d point);
+
+/*!
+UndistortPoint для четырех углов документа
+\param[in] camera Модель камеры, пустая модель копирует углы как есть
+\param[in] corners Углы на снимке
+\param[out] undistorted Углы на изображении без дисторсии
+*/
+void UndistortCorners(const CameraModel& camera, const cv::Point2f corners[4], cv::Point2f undistorted[4]);
+
+/*!
+Готовая таблица пересчета координат для cv::remap: для каждого пикселя результата хранится точка источника.
+Строится из WarpPlan один раз, после этого исправление не считает ни матрицу, ни деление на w.
+Если все точки источника укладываются в 16 бит, таблица хранится в формате с фиксированной точкой
+(CV_16SC2 и CV_16UC1, 6 байт на пиксель), иначе в CV_32FC2.
+*/
+struct RemapTable
+{
+    cv::Mat map1; //!<координаты источника: CV_16SC2 или CV_32FC2
+    cv::Mat map2; //!<дробные части для CV_16SC2, пустая для ближайшего соседа и CV_32FC2
+    int interpolation = cv::INTER_LINEAR; //!<интерполяция, для которой построена таблица
+};
+
+/*!
+Движок исправления перспективы.
+Не хранит изменяемого состояния и не зависит от GLFW/OpenGL, поэтому один экземпляр можно
+одновременно вызывать из любого числа потоков. Каждый вызов работает только со своими буферами,
+ошибки возвращаются значением SolverStatus, исключения OpenCV наружу не выходят.
+*/
+class PerspectiveSolver
+{
+public:
+    /*!
+    \param[in] geometry Как выбирать размер исправленного изображения
+    \param[in] backend Чем исправлять перспективу
+    \param[in] layout В каком виде Rectify и Warp без явного вида пишут результат, например серый для документов
+    */
+    explicit PerspectiveSolver(const OutputGeometry& geometry = OutputGeometry(), WarpBackend backend = WARP_OPENCV, WarpLayout layout = WARP_LAYOUT_SOURCE);
+
+    /*!
+    Загружает изображение с диска
+    \param[in] path Путь до изображения
+    \param[out] image Загруженное изображение в формате BGR
+    \returns результат загрузки
+    */
+    SolverStatus Load(const std::string& path, cv::Mat& image) const;
+
+    /*!
+    Декодирует изображение из памяти
+    \param[in] bytes Содержимое файла изображения, одна строка CV_8U
+    \param[out] image Декодированное изображение в формате BGR
+    \returns результат декодирования
+    */
+    SolverStatus Decode(const cv::Mat& bytes, cv::Mat& image) const;
+
+    /*!
+    Загружает с диска только часть изображения вокруг четырехугольника с запасом для интерполяции.
+    JPEG декодируется построчно с обрезкой по MCU, тайловый TIFF - по тайлам (если движок собран с
+    SOLVER_HAVE_LIBJPEG_TURBO и SOLVER_HAVE_LIBTIFF), остальные файлы декодируются целиком и обрезаются
+    \param[in] path Путь до изображения
+    \param[in] corners Углы документа на полном изображении в любом порядке
+    \param[out] image Часть изображения в формате BGR
+    \param[out] origin Где на полном изображении лежит левый верхний пиксель image, для OffsetPlan
+    \returns результат загрузки
+    */
+    SolverStatus LoadRegion(const std::string& path, const cv::Point2f corners[4], cv::Mat& image, cv::Point& origin) const;
+
+    /*!
+    Декодирует из памяти только часть изображения вокруг четырехугольника, как LoadRegion
+    \param[in] bytes Содержимое файла изображения, одна строка CV_8U
+    \param[in] corners Углы документа на полном изображении в любом порядке
+    \param[out] image Часть изображения в формате BGR
+    \param[out] origin Где на полном изображении лежит левый верхний пиксель image
+    \returns результат декодирования
+    */
+    SolverStatus DecodeRegion(const cv::Mat& bytes, const cv::Point2f corners[4], cv::Mat& image, cv::Point& origin) const;
+
+    /*!
+    Исправляет перспективу изображения
+    \param[in] source Исходное изображение
+    \param[in] corners Углы документа на исходном изображении в любом порядке
+    \param[out] result Исправленное изображение
+    \param[in] size Размер результата, по умолчанию OutputSize(corners); меньший размер нужен для быстрого предпросмотра
+    \param[in] layout В каком виде писать результат, например BGRA для загрузки в текстуру
+    \returns результат исправления
+    */
+    SolverStatus Warp(const cv::Mat& source, const cv::Point2f corners[4], cv::Mat& result, cv::Size size, WarpLayout layout) const;
+
+    /*!
+    Исправляет перспективу изображения в виде Layout()
+    */
+    SolverStatus Warp(const cv::Mat& source, const cv::Point2f corners[4], cv::Mat& result, cv::Size size = cv::Size()) const { return Warp(source, corners, result, size, layout); }
+
+    /*!
+    Считает матрицу исправления для углов, саму картинку не трогает
+    \param[in] corners Углы документа на исходном изображении в любом порядке
+    \param[out] plan Матрица и размер результата
+    \param[in] size Размер результата, по умолчанию OutputSize(corners)
+    \returns SOLVER_OK или SOLVER_BAD_CORNERS, если углы вырождены или среди координат есть nan или бесконечность
+    */
+    SolverStatus Plan(const cv::Point2f corners[4], WarpPlan& plan, cv::Size size = cv::Size()) const;
+
+    /*!
+    Исправляет перспективу по заранее посчитанной матрице
+    \param[in] source Исходное изображение
+    \param[in] plan Результат Plan
+    \param[out] result Исправленное изображение, буфер переиспользуется если размер и тип совпадают
+    \param[in] layout В каком виде писать результат. Ядро WARP_SIMD пишет его сразу, без промежуточного буфера,
+    WARP_OPENCV переводит результат отдельным проходом cvtColor
+    \returns результат исправления
+    */
+    SolverStatus Warp(const cv::Mat& source, const WarpPlan& plan, cv::Mat& result, WarpLayout layout) const;
+
+    /*!
+    Исправляет перспективу по заранее посчитанной матрице в виде Layout()
+    */
+    SolverStatus Warp(const cv::Mat& source, const WarpPlan& plan, cv::Mat& result) const { return Warp(source, plan, result, layout); }
+
+    /*!
+    Строит таблицу пересчета координат для заранее посчитанной матрицы.
+    С моделью камеры таблица сразу ведет из пикселя результата через обратную матрицу и DistortPoint в точку снимка,
+    поэтому дисторсия снимается тем же единственным cv::remap, без отдельного cv::undistort и второй интерполяции
+    \param[in] plan Результат Plan для углов без дисторсии (UndistortCorners от отмеченных углов)
+    \param[in] interpolation cv::INTER_NEAREST, INTER_LINEAR, INTER_CUBIC или INTER_LANCZOS4
+    \param[out] table Таблица размера plan.size
+    \param[in] camera Модель камеры снимка, по умолчанию пустая
+    \returns SOLVER_OK или SOLVER_BAD_CORNERS, если матрица необратима
+    */
+    SolverStatus BuildRemap(const WarpPlan& plan, int interpolation, RemapTable& table, const CameraModel& camera = CameraModel()) const;
+
+    /*!
+    Строит таблицу пересчета сразу по углам, отмеченным на снимке с дисторсией: матрица считается по углам без нее
+    \param[in] corners Углы документа на снимке в любом порядке
+    \param[in] camera Модель камеры снимка
+    \param[in] interpolation cv::INTER_NEAREST, INTER_LINEAR, INTER_CUBIC или INTER_LANCZOS4
+    \param[out] table Таблица пересчета
+    \param[in] size Размер результата, по умолчанию OutputSize от углов без дисторсии
+    \returns SOLVER_OK или SOLVER_BAD_CORNERS
+    */
+    SolverStatus BuildRemap(const cv::Point2f corners[4], const CameraModel& camera, int interpolation, RemapTable& table, cv::Size size = cv::Size()) const;
+
+    /*!
+    Исправляет перспективу по готовой таблице, выбор ядра при этом не действует
+    \param[in] source Исходное изображение
+    \param[in] table Результат BuildRemap
+    \param[out] result Исправленное изображение размера таблицы
+    \param[in] layout В каком виде писать результат, перевод идет отдельным проходом после cv::remap
+    \returns результат исправления
+    */
+    SolverStatus Warp(const cv::Mat& source, const RemapTable& table, cv::Mat& result, WarpLayout layout) const;
+
+    /*!
+    Исправляет перспективу по готовой таблице в виде Layout()
+    */
+    SolverStatus Warp(const cv::Mat& source, const RemapTable& table, cv::Mat& result) const { return Warp(source, table, result, layout); }
+
+    /*!
+    Сохраняет изображение на диск, формат определяется расширением пути
+    \param[in] path Путь, куда надо сохранить
+    \param[in] result Исправленное изображение
+    \param[in] params Параметры кодирования для cv::imwrite
+    \returns результат сохранения
+    */
+    SolverStatus Save(const std::string& path, const cv::Mat& result, const std::vector<int>& params = std::vector<int>()) const;
+
+    /*!
+    Кодирует изображение в память
+    \param[in] extension Формат в виде расширения файла, например ".jpg"
+    \param[in] result Исправленное изображение
+    \param[out] bytes Закодированный файл
+    \param[in] params Параметры кодирования для cv::imencode
+    \returns результат кодирования
+    */
+    SolverStatus Encode(const std::string& extension, const cv::Mat& result, std::vector<uchar>& bytes, const std::vector<int>& params = std::vector<int>()) const;
+
+    /*!
+    Загружает, исправляет и сохраняет одно изображение
+    \param[in] input Путь до исходного изображения
+    \param[in] corners Углы документа на исходном изображении в любом порядке
+    \param[in] output Путь, куда сохранить результат
+    \returns результат первой неудавшейся операции или SOLVER_OK
+    Декодируется только часть изображения вокруг углов, см. LoadRegion
+    */
+    SolverStatus Rectify(const std::string& input, const cv::Point2f corners[4], const std::string& output) const;
+
+    /*!
+    Загружает, исправляет по готовой таблице и сохраняет одно изображение
+    \param[in] input Путь до исходного изображения
+    \param[in] table Таблица профиля
+    \param[in] output Путь, куда сохранить результат
+    \returns результат первой неудавшейся операции или SOLVER_OK
+    */
+    SolverStatus Rectify(const std::string& input, const RemapTable& table, const std::string& output) const;
+
+    /*!
+    Загружает и исправляет одно изображение, не сохраняя, чтобы вызывающий закодировал его сам
+    \param[in] input Путь до исходного изображения
+    \param[in] corners Углы документа на исходном изображении в любом порядке
+    \param[out] result Исправленное изображение
+    \returns результат первой неудавшейся операции или SOLVER_OK
+    */
+    SolverStatus Rectify(const std::string& input, const cv::Point2f corners[4], cv::Mat& result) const;
+
+    /*!
+    Загружает и исправляет по готовой таблице одно изображение, не сохраняя
+    \param[in] input Путь до исходного изображения
+    \param[in] table Таблица профиля
+    \param[out] result Исправленное изображение
+    \returns результат первой неудавшейся операции или SOLVER_OK
+    */
+    SolverStatus Rectify(const std::string& input, const RemapTable& table, cv::Mat& result) const;
+
+    /*!
+    \param[in] corners Углы документа в любом порядке
+    \returns Размер, в который Warp исправит эти углы по умолчанию
+    */
+    cv::Size OutputSize(const cv::Point2f corners[4]) const { return ComputeOutputSize(corners, geometry); }
+
+    const OutputGeometry& Geometry() const { return geometry; }
+    WarpBackend Backend() const { return backend; }
+    WarpLayout Layout() const { return layout; }
+
+private:
+    OutputGeometry geometry; //!<как выбирать размер исправленного изображения
+    WarpBackend backend; //!<чем исправлять перспективу
+    WarpLayout layout; //!<в каком виде Rectify и Warp без явного вида пишут результат
+};
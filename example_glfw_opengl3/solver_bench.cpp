@@ -0,0 +1,277 @@
+// Набор микробенчмарков всех стадий: углы, матрица, исправление, декодирование, кодирование, загрузка в текстуру.
+// Запуск: solver_bench [--megapixels N] [--repeats N] [--json out.json] [--compare baseline.json] [--threshold %] [--no-gl]
+// Загрузка в текстуру меряется в скрытом окне GLFW; без дисплея можно использовать программный Mesa (LIBGL_ALWAYS_SOFTWARE=1 под Xvfb).
+
+#include "solver.h"
+#include "save_queue.h"
+#include "gl_texture.h"
+
+#include <GLFW/glfw3.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+/*!
+Результат одного бенчмарка
+*/
+struct BenchResult
+{
+    string name; //!<имя, по нему сравнивается с базовым прогоном
+    double us; //!<среднее время одного вызова в микросекундах
+};
+
+/*!
+Среднее время одного вызова в микросекундах
+*/
+template<typename F>
+static double TimeUs(int repeats, F body)
+{
+    body(); //прогрев: выделение результата и кэши
+    auto started = chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) body();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - started).count() / repeats;
+}
+
+/*!
+Синтетический снимок: плавные пятна вместо шума, чтобы кодеки сжимали его как фотографию
+*/
+static Mat SyntheticImage(double megapixels)
+{
+    int width = (int)sqrt(megapixels * 1e6 * 4 / 3);
+    int height = width * 3 / 4;
+
+    Mat seed(48, 64, CV_8UC3), image;
+    randu(seed, Scalar::all(0), Scalar::all(255));
+    resize(seed, image, Size(width, height), 0, 0, INTER_CUBIC);
+    return image;
+}
+
+/*!
+Читает результаты из JSON, записанного WriteJson. Полноценный разбор JSON не нужен: формат свой.
+*/
+static bool ReadJson(const string& path, map<string, double>& results)
+{
+    ifstream file(path);
+    if (!file.is_open()) return false;
+
+    string line;
+    while (getline(file, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t us = line.find("\"us\": ");
+        if (name == string::npos || us == string::npos) continue;
+        name += 9;
+        results[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + us + 6);
+    }
+    return true;
+}
+
+static bool WriteJson(const string& path, double megapixels, const vector<BenchResult>& results)
+{
+    ofstream file(path);
+    if (!file.is_open()) return false;
+
+    file << "{\n  \"megapixels\": " << megapixels << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        file << "    { \"name\": \"" << results[i].name << "\", \"us\": " << results[i].us << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
+
+/*!
+Загрузка в текстуру через GLTexture в скрытом окне
+\returns false если не удалось создать контекст OpenGL
+*/
+static bool BenchUpload(const Mat& image, int repeats, vector<BenchResult>& results)
+{
+    if (!glfwInit()) return false;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "solver_bench", NULL, NULL);
+    if (window == NULL) {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+
+#if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
+    bool err = gl3wInit() != 0;
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLEW)
+    bool err = glewInit() != GLEW_OK;
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
+    bool err = gladLoadGL() == 0;
+#else
+    bool err = false;
+#endif
+    if (!err) {
+        printf("GL renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+        //glFinish после каждой загрузки, иначе меряется только постановка в очередь драйвера
+        GLTexture texture;
+        Mat small;
+        resize(image, small, Size(1024, image.rows * 1024 / image.cols), 0, 0, INTER_AREA);
+        results.push_back({ "upload_preview_1024", TimeUs(repeats, [&]() { BindCVMat2GLTexture(small, texture); glFinish(); }) });
+        results.push_back({ "upload_full", TimeUs(repeats, [&]() { BindCVMat2GLTexture(image, texture); glFinish(); }) });
+        texture.Release();
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return !err;
+}
+
+int main(int argc, char** argv)
+{
+    double megapixels = 12;
+    int repeats = 10;
+    double threshold = 10;
+    bool use_gl = true;
+    string json_path, baseline_path;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--megapixels" && i + 1 < argc) megapixels = atof(argv[++i]);
+        else if (arg == "--repeats" && i + 1 < argc) repeats = max(1, atoi(argv[++i]));
+        else if (arg == "--json" && i + 1 < argc) json_path = argv[++i];
+        else if (arg == "--compare" && i + 1 < argc) baseline_path = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (arg == "--no-gl") use_gl = false;
+        else {
+            fprintf(stderr, "Usage: %s [--megapixels N] [--repeats N] [--json out.json] [--compare baseline.json] [--threshold %%] [--no-gl]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Mat image = SyntheticImage(megapixels);
+    printf("source %dx%d, warp kernel %s, %d repeats\n", image.cols, image.rows, WarpKernelName(), repeats);
+
+    //четырехугольник, похожий на сфотографированный под углом лист
+    float w = (float)image.cols, h = (float)image.rows;
+    Point2f quad[4] = { Point2f(w * 0.12f, h * 0.08f), Point2f(w * 0.91f, h * 0.15f), Point2f(w * 0.05f, h * 0.93f), Point2f(w * 0.86f, h * 0.97f) };
+
+    vector<BenchResult> results;
+    PerspectiveSolver solver;
+    PerspectiveSolver simd_solver(OutputGeometry(), WARP_SIMD);
+    OutputGeometry from_quad;
+    from_quad.mode = OUTPUT_QUAD;
+
+    //вычисления над углами очень короткие, поэтому каждое повторяется внутри замера
+    const int inner = 10000;
+    results.push_back({ "sort_points", TimeUs(repeats, [&]() {
+        for (int i = 0; i < inner; i++) { Point2f points[4] = { quad[3], quad[0], quad[2], quad[1] }; SortPoints(points); }
+    }) / inner });
+    results.push_back({ "output_size", TimeUs(repeats, [&]() {
+        for (int i = 0; i < inner; i++) ComputeOutputSize(quad, from_quad);
+    }) / inner });
+    WarpPlan plan;
+    results.push_back({ "perspective_transform", TimeUs(repeats, [&]() {
+        for (int i = 0; i < inner; i++) solver.Plan(quad, plan);
+    }) / inner });
+
+    int sizes[] = { 500, 1000, 2000, 4000 };
+    for (int size : sizes) {
+        WarpPlan sized;
+        solver.Plan(quad, sized, Size(size, size));
+        Mat result;
+        results.push_back({ "warp_opencv_" + to_string(size), TimeUs(repeats, [&]() { solver.Warp(image, sized, result); }) });
+        results.push_back({ "warp_simd_" + to_string(size), TimeUs(repeats, [&]() { simd_solver.Warp(image, sized, result); }) });
+    }
+
+    //кодирование в каждый формат, заодно получаем файлы для замера декодирования
+    SaveFormat formats[] = { SAVE_JPEG, SAVE_PNG, SAVE_WEBP };
+    const char* format_names[] = { "jpeg", "png", "webp" };
+    for (int f = 0; f < 3; f++) {
+        SaveOptions options;
+        options.format = formats[f];
+        string path = string("solver_bench") + SaveFormatExtension(formats[f]);
+        results.push_back({ string("imwrite_") + format_names[f], TimeUs(repeats, [&]() { solver.Save(path, image, SaveParams(options)); }) });
+    }
+
+    //кодировщики с настройками: время в общей таблице, размер файла отдельно
+    vector<pair<string, string>> encoders = {
+        { "jpeg_420", "jpeg" }, { "jpeg_444", "jpeg:subsampling=444" }, { "jpeg_progressive", "jpeg:progressive" },
+        { "png_3", "png:level=3" }, { "png_rle", "png:level=3,strategy=rle" }, { "png_9_filtered", "png:level=9,strategy=filtered" },
+        { "webp_90", "webp:quality=90" }, { "webp_lossless", "webp:lossless" }, { "jxl_lossless", "jxl:effort=3" },
+    };
+    struct EncodedSize { string name; size_t bytes; const char* encoder; };
+    vector<EncodedSize> encoded_sizes;
+    for (const auto& encoder : encoders) {
+        SaveOptions options;
+        ParseSaveOptions(encoder.second, options);
+        if (!EncoderAvailable(options.format)) continue;
+        vector<uchar> bytes;
+        results.push_back({ "encode_" + encoder.first, TimeUs(repeats, [&]() { EncodeImage(image, options, bytes); }) });
+        encoded_sizes.push_back({ "encode_" + encoder.first, bytes.size(), EncoderName(options.format) });
+    }
+
+    for (int f = 0; f < 2; f++) {
+        string path = string("solver_bench") + SaveFormatExtension(formats[f]);
+        Mat decoded;
+        results.push_back({ string("imread_") + format_names[f], TimeUs(repeats, [&]() { decoded = imread(path); }) });
+        results.push_back({ string("load_mmap_") + format_names[f], TimeUs(repeats, [&]() { solver.Load(path, decoded); }) });
+        results.push_back({ string("stbi_load_") + format_names[f], TimeUs(repeats, [&]() {
+            int width, height, channels;
+            stbi_image_free(stbi_load(path.c_str(), &width, &height, &channels, 3));
+        }) });
+    }
+    for (int f = 0; f < 3; f++) {
+        remove((string("solver_bench") + SaveFormatExtension(formats[f])).c_str());
+    }
+
+    if (use_gl && !BenchUpload(image, repeats, results)) {
+        printf("OpenGL context is not available, upload benchmarks skipped\n");
+    }
+
+    map<string, double> baseline;
+    bool compare = !baseline_path.empty();
+    if (compare && !ReadJson(baseline_path, baseline)) {
+        fprintf(stderr, "Failed to read baseline %s\n", baseline_path.c_str());
+        return 1;
+    }
+
+    int regressions = 0;
+    printf("%-24s %14s", "benchmark", "us");
+    if (compare) printf(" %14s %8s", "baseline us", "change");
+    printf("\n");
+    for (const BenchResult& result : results) {
+        printf("%-24s %14.3f", result.name.c_str(), result.us);
+        auto old = baseline.find(result.name);
+        if (compare && old != baseline.end() && old->second > 0) {
+            double change = (result.us / old->second - 1) * 100;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            printf(" %14.3f %+7.1f%%%s", old->second, change, regressed ? "  REGRESSION" : "");
+        }
+        printf("\n");
+    }
+    for (const EncodedSize& encoded : encoded_sizes) {
+        printf("%-24s %14d bytes, %s\n", encoded.name.c_str(), (int)encoded.bytes, encoded.encoder);
+    }
+
+    if (!json_path.empty() && !WriteJson(json_path, megapixels, results)) {
+        fprintf(stderr, "Failed to write %s\n", json_path.c_str());
+        return 1;
+    }
+    if (regressions > 0) {
+        printf("%d benchmarks are more than %.0f%% slower than the baseline\n", regressions, threshold);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "stream.h"
+#include "bounded_queue.h"
+#include "mapped_file.h"
+
+#include <opencv2/core/utils/filesystem.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+/*!
+Кадр, который передается между стадиями конвейера
+*/
+struct StreamFrame
+{
+    int index = 0; //!<номер кадра
+    string name; //!<файл кадра или его номер, для сообщений и имени результата
+    Mat image; //!<пиксели
+    Point origin; //!<где на полном кадре лежит левый верхний пиксель image
+};
+
+/*!
+Вход - последовательность изображений, а не видеофайл
+*/
+static bool IsSequence(const string& path)
+{
+    return path.find_first_of("*?") != string::npos || utils::fs::isDirectory(path);
+}
+
+/*!
+Имя файла без папки
+*/
+static string FileName(const string& path)
+{
+    size_t slash = path.find_last_of("\\/");
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+static double SecondsSince(chrono::steady_clock::time_point started)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
+
+int RunStream(const char* input, const char* output, const Point2f corners[4], const PerspectiveSolver& solver, size_t depth)
+{
+    string in(input);
+    string out(output);
+
+    //матрица одна на все кадры
+    WarpPlan plan;
+    SolverStatus planned = solver.Plan(corners, plan);
+    if (planned != SOLVER_OK) {
+        cerr << SolverStatusText(planned) << endl;
+        return 1;
+    }
+
+    bool from_images = IsSequence(in);
+    bool to_images = utils::fs::isDirectory(out);
+
+    vector<string> files;
+    VideoCapture capture;
+    double fps = 25;
+    if (from_images) {
+        glob(in, files);
+        if (files.empty()) {
+            cerr << "No images in " << in << endl;
+            return 1;
+        }
+    }
+    else {
+        capture.open(in);
+        if (!capture.isOpened()) {
+            cerr << "Failed to open video " << in << endl;
+            return 1;
+        }
+        if (capture.get(CAP_PROP_FPS) > 0) fps = capture.get(CAP_PROP_FPS);
+    }
+
+    BoundedQueue<StreamFrame> decoded(depth); //!<декодированные кадры ждут исправления
+    BoundedQueue<StreamFrame> warped(depth); //!<исправленные кадры ждут кодирования
+    atomic<int> failed(0);
+    mutex log_mutex;
+
+    auto report = [&](const string& name, SolverStatus status) {
+        failed++;
+        lock_guard<mutex> lock(log_mutex);
+        cerr << name << ": " << SolverStatusText(status) << endl;
+    };
+
+    //время работы каждой стадии без ожидания очередей, самая занятая стадия ограничивает скорость
+    double decode_seconds = 0, warp_seconds = 0, encode_seconds = 0;
+    int frames = 0;
+
+    auto started = chrono::steady_clock::now();
+
+    //при чтении папки ядро заранее читает в кэш кадры, которые понадобятся после заполнения очереди
+    size_t lookahead = depth + 2;
+    for (size_t i = 0; i < lookahead && i < files.size(); i++) {
+        PrefetchFile(files[i]);
+    }
+
+    thread decoder([&]() {
+        for (int i = 0; ; i++) {
+            auto frame_started = chrono::steady_clock::now();
+            StreamFrame frame;
+            frame.index = i;
+            if (from_images) {
+                if (i >= (int)files.size()) break;
+                if (i + lookahead < files.size()) PrefetchFile(files[i + lookahead]);
+                frame.name = files[i];
+
+                //из файла декодируется только часть кадра вокруг углов, видео декодируется целиком
+                SolverStatus status = solver.LoadRegion(files[i], corners, frame.image, frame.origin);
+                if (status != SOLVER_OK) {
+                    report(frame.name, status);
+                    continue;
+                }
+            }
+            else {
+                if (!capture.read(frame.image) || frame.image.empty()) break;
+                frame.name = "frame " + to_string(i);
+            }
+            decode_seconds += SecondsSince(frame_started);
+
+            if (!decoded.Push(move(frame))) break;
+        }
+        decoded.Close();
+    });
+
+    thread warper([&]() {
+        StreamFrame frame;
+        while (decoded.Pop(frame)) {
+            auto frame_started = chrono::steady_clock::now();
+            StreamFrame result;
+            result.index = frame.index;
+            result.name = frame.name;
+            SolverStatus status = solver.Warp(frame.image, OffsetPlan(plan, frame.origin), result.image);
+            warp_seconds += SecondsSince(frame_started);
+
+            if (status != SOLVER_OK) {
+                report(frame.name, status);
+                continue;
+            }
+            if (!warped.Push(move(result))) break;
+        }
+        warped.Close();
+    });
+
+    //кодирование идет в вызывающем потоке, кадры приходят по порядку
+    VideoWriter writer;
+    StreamFrame frame;
+    while (warped.Pop(frame)) {
+        auto frame_started = chrono::steady_clock::now();
+        SolverStatus status = SOLVER_OK;
+        if (to_images) {
+            char name[32];
+            snprintf(name, sizeof(name), "%06d.jpg", frame.index);
+            status = solver.Save(out + "/" + (from_images ? FileName(frame.name) : string(name)), frame.image);
+        }
+        else {
+            if (!writer.isOpened()) {
+                writer.open(out, VideoWriter::fourcc('m', 'p', '4', 'v'), fps, frame.image.size(), frame.image.channels() != 1);
+            }
+            if (writer.isOpened()) writer.write(frame.image);
+            else {
+                //без писателя продолжать бессмысленно: останавливаем остальные стадии
+                report(out, SOLVER_SAVE_FAILED);
+                decoded.Close();
+                warped.Close();
+                break;
+            }
+        }
+        encode_seconds += SecondsSince(frame_started);
+
+        if (status != SOLVER_OK) report(frame.name, status);
+        else frames++;
+    }
+
+    decoder.join();
+    warper.join();
+    writer.release();
+
+    double seconds = SecondsSince(started);
+    cout << frames << " frames done in " << seconds << " s (" << (seconds > 0 ? frames / seconds : 0) << " fps), busy: decode "
+        << decode_seconds << " s, warp " << warp_seconds << " s, encode " << encode_seconds << " s" << endl;
+
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+#include <opencv2/core/core.hpp>
+
+#include "solver.h"
+
+/*!
+Исправляет перспективу всех кадров видео или последовательности изображений по одним и тем же углам.
+Работает конвейером из трех стадий в отдельных потоках: декодирование, исправление, кодирование.
+Стадии связаны очередями длины depth, поэтому кадры обрабатываются одновременно на всех стадиях,
+а в памяти находится не больше нескольких кадров. Матрица исправления считается один раз.
+\param[in] input Видеофайл, папка с изображениями или шаблон вида "frames/img_*.png"
+\param[in] output Видеофайл или существующая папка, куда сохранить исправленные кадры
+\param[in] corners Углы документа на кадре в любом порядке
+\param[in] solver Движок с выбранными ядром и геометрией результата
+\param[in] depth Сколько кадров может ждать между стадиями
+\returns код возврата процесса: 0 если все кадры обработаны успешно
+*/
+int RunStream(const char* input, const char* output, const cv::Point2f corners[4], const PerspectiveSolver& solver, size_t depth = 4);
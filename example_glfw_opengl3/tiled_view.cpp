@@ -0,0 +1,186 @@
+#include "tiled_view.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+using namespace std;
+using namespace cv;
+
+const float MAX_ZOOM = 16; //!<наибольшее увеличение, пикселей экрана на пиксель изображения
+const float WHEEL_STEP = 1.25f; //!<во сколько раз меняется масштаб за щелчок колеса
+
+static uint64_t TileKey(int level, int tile_x, int tile_y)
+{
+    return (uint64_t)level << 48 | (uint64_t)tile_y << 24 | (uint64_t)tile_x;
+}
+
+TiledImageView::TiledImageView(size_t budget) : budget(budget), used(0), frame(0), zoom(0), pan(0, 0), origin(0, 0), panning(false), pending(false)
+{
+}
+
+TiledImageView::~TiledImageView()
+{
+    Release();
+}
+
+void TiledImageView::SetImage(const PreviewPyramid& image)
+{
+    Release();
+    pyramid = image;
+}
+
+void TiledImageView::Release()
+{
+    //у GLTexture нет копирования, поэтому плитки удаляются вместе с узлами таблицы
+    tiles.clear();
+    lru.clear();
+    used = 0;
+    pyramid.Release();
+    staging.release();
+    zoom = 0;
+    pan = ImVec2(0, 0);
+    panning = false;
+    pending = false;
+}
+
+bool TiledImageView::Draw(const char* id, const ImVec2& size)
+{
+    ImVec2 area_min = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton(id, ImVec2(max(size.x, 1.0f), max(size.y, 1.0f)));
+    bool hovered = ImGui::IsItemHovered();
+    pending = false;
+    if (pyramid.Levels() == 0) return hovered;
+
+    SOLVER_PROFILE_SCOPE("tiled_view");
+    frame++;
+
+    const Mat& full = pyramid.Level(0);
+    float fit = min(size.x / full.cols, size.y / full.rows);
+    if (zoom <= 0) {
+        zoom = fit;
+        pan = ImVec2(0, 0);
+    }
+
+    //колесо меняет масштаб так, что точка под курсором остается на месте
+    ImGuiIO& io = ImGui::GetIO();
+    ImVec2 mouse(io.MousePos.x - area_min.x, io.MousePos.y - area_min.y);
+    if (hovered && io.MouseWheel != 0) {
+        ImVec2 anchor(pan.x + mouse.x / zoom, pan.y + mouse.y / zoom);
+        zoom = min(max(zoom * pow(WHEEL_STEP, io.MouseWheel), fit), MAX_ZOOM);
+        pan = ImVec2(anchor.x - mouse.x / zoom, anchor.y - mouse.y / zoom);
+    }
+
+    //правая или средняя кнопка тащат изображение
+    if (hovered && (ImGui::IsMouseClicked(1) || ImGui::IsMouseClicked(2))) panning = true;
+    if (panning) {
+        if (ImGui::IsMouseDown(1) || ImGui::IsMouseDown(2)) pan = ImVec2(pan.x - io.MouseDelta.x / zoom, pan.y - io.MouseDelta.y / zoom);
+        else panning = false;
+    }
+
+    //изображение не уезжает за край области
+    pan.x = min(max(pan.x, 0.0f), max(0.0f, full.cols - size.x / zoom));
+    pan.y = min(max(pan.y, 0.0f), max(0.0f, full.rows - size.y / zoom));
+    origin = ImVec2(area_min.x - pan.x * zoom, area_min.y - pan.y * zoom);
+
+    //подробный уровень - самый маленький, у которого пиксель еще не крупнее пикселя экрана
+    int top = pyramid.Levels() - 1;
+    int level = 0;
+    while (level < top && pyramid.Scale(level + 1) * zoom <= 1.0f) level++;
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->PushClipRect(area_min, ImVec2(area_min.x + size.x, area_min.y + size.y), true);
+
+    //под подробными плитками всегда лежит верхний уровень: он мал и показывается, пока подробные грузятся
+    int uploads = 0;
+    DrawLevel(draw_list, top, size, uploads);
+    if (level != top) DrawLevel(draw_list, level, size, uploads);
+
+    draw_list->PopClipRect();
+    Evict();
+    return hovered;
+}
+
+void TiledImageView::DrawLevel(ImDrawList* draw_list, int level, const ImVec2& area_size, int& uploads)
+{
+    const Mat& full = pyramid.Level(0);
+    const Mat& image = pyramid.Level(level);
+
+    //pyrDown округляет вверх, поэтому масштаб по осям считается отдельно
+    float scale_x = (float)full.cols / image.cols;
+    float scale_y = (float)full.rows / image.rows;
+
+    //видимая часть уровня в плитках
+    int first_x = max(0, (int)floor(pan.x / scale_x / TILE_SIZE));
+    int first_y = max(0, (int)floor(pan.y / scale_y / TILE_SIZE));
+    int last_x = min((image.cols - 1) / TILE_SIZE, (int)floor((pan.x + area_size.x / zoom) / scale_x / TILE_SIZE));
+    int last_y = min((image.rows - 1) / TILE_SIZE, (int)floor((pan.y + area_size.y / zoom) / scale_y / TILE_SIZE));
+
+    for (int tile_y = first_y; tile_y <= last_y; tile_y++) {
+        for (int tile_x = first_x; tile_x <= last_x; tile_x++) {
+            Tile* tile = Request(level, tile_x, tile_y, uploads);
+            if (tile == NULL) continue;
+
+            int x = tile_x * TILE_SIZE;
+            int y = tile_y * TILE_SIZE;
+            ImVec2 p0(origin.x + x * scale_x * zoom, origin.y + y * scale_y * zoom);
+            ImVec2 p1(origin.x + (x + tile->texture.Width()) * scale_x * zoom, origin.y + (y + tile->texture.Height()) * scale_y * zoom);
+            draw_list->AddImage((void*)(intptr_t)tile->texture.Id(), p0, p1);
+        }
+    }
+}
+
+TiledImageView::Tile* TiledImageView::Request(int level, int tile_x, int tile_y, int& uploads)
+{
+    uint64_t key = TileKey(level, tile_x, tile_y);
+    auto found = tiles.find(key);
+    if (found != tiles.end()) {
+        Tile& tile = found->second;
+        lru.splice(lru.begin(), lru, tile.position);
+        tile.frame = frame;
+        return &tile;
+    }
+
+    if (uploads >= MAX_UPLOADS_PER_FRAME) {
+        pending = true;
+        return NULL;
+    }
+    uploads++;
+
+    const Mat& image = pyramid.Level(level);
+    Rect region(tile_x * TILE_SIZE, tile_y * TILE_SIZE, 0, 0);
+    region.width = min(image.cols - region.x, (int)TILE_SIZE);
+    region.height = min(image.rows - region.y, (int)TILE_SIZE);
+
+    Tile& tile = tiles.emplace(piecewise_construct, forward_as_tuple(key), forward_as_tuple()).first->second;
+    //плитка - несплошной кусок уровня, переводим ее в общий буфер, и текстура загружает его как есть
+    staging.create(TILE_SIZE, TILE_SIZE, CV_8UC4);
+    Mat bgra(region.size(), CV_8UC4, staging.data);
+    ConvertToBGRA(image(region), bgra);
+    tile.texture.Update(bgra);
+
+    //край плитки не смешивается с цветом границы, иначе между плитками видны швы
+    glBindTexture(GL_TEXTURE_2D, tile.texture.Id());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    tile.bytes = (size_t)region.width * region.height * 4;
+    tile.frame = frame;
+    lru.push_front(key);
+    tile.position = lru.begin();
+    used += tile.bytes;
+    return &tile;
+}
+
+void TiledImageView::Evict()
+{
+    //плитки текущего кадра не трогаем, даже если бюджет превышен: без них нечего показать
+    while (used > budget && !lru.empty()) {
+        auto found = tiles.find(lru.back());
+        if (found->second.frame == frame) break;
+        used -= found->second.bytes;
+        lru.pop_back();
+        tiles.erase(found);
+    }
+}
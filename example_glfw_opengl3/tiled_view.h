@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#include <opencv2/core/core.hpp>
+
+#include "imgui.h"
+#include "gl_texture.h"
+#include "preview.h"
+
+/*!
+Просмотр изображения любого размера по плиткам.
+Уровни PreviewPyramid нарезаются на плитки TILE_SIZE x TILE_SIZE, в видеопамять загружаются только плитки,
+видимые при текущем масштабе и сдвиге, поэтому изображение может быть больше GL_MAX_TEXTURE_SIZE.
+Давно не показанные плитки удаляются, когда занятая видеопамять превышает бюджет.
+Колесо мыши меняет масштаб вокруг курсора, правая или средняя кнопка двигают изображение,
+левая кнопка остается вызывающему (ImGui::IsItemClicked после Draw).
+Все методы надо вызывать из потока, где текущий контекст OpenGL.
+*/
+class TiledImageView
+{
+public:
+    static const int TILE_SIZE = 512; //!<сторона плитки в пикселях уровня
+    static const int MAX_UPLOADS_PER_FRAME = 8; //!<сколько плиток загружать за кадр, чтобы кадр не затягивался
+    static const size_t DEFAULT_BUDGET = (size_t)256 << 20; //!<видеопамять под плитки по умолчанию
+
+    /*!
+    \param[in] budget Сколько байт видеопамяти могут занимать плитки
+    */
+    explicit TiledImageView(size_t budget = DEFAULT_BUDGET);
+    ~TiledImageView();
+
+    TiledImageView(const TiledImageView&) = delete;
+    TiledImageView& operator=(const TiledImageView&) = delete;
+
+    /*!
+    Показывает новое изображение целиком в размер области
+    \param[in] pyramid Уровни изображения, нулевой - полное разрешение. Матрицы не копируются
+    */
+    void SetImage(const PreviewPyramid& pyramid);
+
+    /*!
+    Удаляет плитки и забывает изображение, должен быть вызван до уничтожения контекста OpenGL
+    */
+    void Release();
+
+    /*!
+    Рисует изображение в текущем окне ImGui и обрабатывает масштаб и сдвиг
+    \param[in] id Идентификатор элемента ImGui
+    \param[in] size Размер области на экране
+    \returns находится ли курсор над областью
+    */
+    bool Draw(const char* id, const ImVec2& size);
+
+    /*!
+    Положение пикселя (0, 0) полного изображения на экране при последнем Draw, может быть вне области
+    */
+    ImVec2 Origin() const { return origin; }
+
+    /*!
+    Сколько пикселей экрана приходится на пиксель полного изображения
+    */
+    float Zoom() const { return zoom; }
+
+    /*!
+    Не все видимые плитки успели загрузиться, нужен еще кадр
+    */
+    bool Pending() const { return pending; }
+
+    size_t UsedBytes() const { return used; }
+
+private:
+    struct Tile
+    {
+        GLTexture texture; //!<пиксели плитки
+        size_t bytes = 0; //!<сколько видеопамяти занимает
+        int64_t frame = 0; //!<в каком кадре плитка показывалась последний раз
+        std::list<uint64_t>::iterator position; //!<место в списке lru
+    };
+
+    /*!
+    Рисует видимые плитки одного уровня, недостающие загружает, пока не исчерпан лимит кадра
+    */
+    void DrawLevel(ImDrawList* draw_list, int level, const ImVec2& area_size, int& uploads);
+
+    /*!
+    Возвращает загруженную плитку или загружает ее
+    \returns NULL если плитку не успели загрузить в этом кадре
+    */
+    Tile* Request(int level, int tile_x, int tile_y, int& uploads);
+
+    /*!
+    Удаляет давно не показанные плитки, пока не уложится в бюджет
+    */
+    void Evict();
+
+    PreviewPyramid pyramid; //!<уровни показываемого изображения
+    cv::Mat staging; //!<один BGRA буфер на все плитки: у каждой текстуры свой держал бы в памяти столько же, сколько сами плитки
+    std::unordered_map<uint64_t, Tile> tiles; //!<загруженные плитки по уровню и номеру
+    std::list<uint64_t> lru; //!<ключи плиток, в начале недавно показанные
+    size_t budget; //!<ограничение видеопамяти
+    size_t used; //!<занятая видеопамять
+    int64_t frame; //!<номер текущего кадра
+
+    float zoom; //!<масштаб, 0 - вписать в область при следующем Draw
+    ImVec2 pan; //!<точка полного изображения в левом верхнем углу области
+    ImVec2 origin; //!<пиксель (0, 0) на экране
+    bool panning; //!<изображение тащат мышью
+    bool pending; //!<остались незагруженные видимые плитки
+};
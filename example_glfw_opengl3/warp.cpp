@@ -0,0 +1,442 @@
+#include "warp.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WARP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//GCC и Clang разрешают интринсики только в функциях, собранных под нужный набор команд,
+//MSVC разрешает их везде
+#if defined(WARP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WARP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define WARP_TARGET(isa)
+#endif
+
+using namespace cv;
+
+namespace {
+
+const int WARP_BITS = 5; //!<точность дробной части координат, как INTER_BITS у OpenCV
+const int WARP_SCALE = 1 << WARP_BITS;
+const int WEIGHT_BITS = 2 * WARP_BITS; //!<сумма четырех весов равна 1 << WEIGHT_BITS
+
+//сколько пикселей строки обрабатывается за один проход по координатам
+const int BLOCK = 256;
+
+//веса BGR в яркость в фиксированной точке, как у cvtColor(COLOR_BGR2GRAY), поэтому результат совпадает до бита
+const int GRAY_BITS = 14;
+const int GRAY_B = 1868, GRAY_G = 9617, GRAY_R = 4899;
+
+/*!
+Считает координаты источника для n подряд идущих пикселей строки результата.
+Координаты записываются в фиксированной точке: целая часть в старших битах, дробная в младших WARP_BITS.
+\param[in] X,Y,W Однородные координаты источника для первого пикселя
+\param[in] dX,dY,dW Приращения однородных координат на один пиксель
+\param[in] n Количество пикселей
+\param[in] xlim,ylim Координаты, дальше которых пиксель заведомо черный, ограничение не дает переполнить int
+\param[out] xs,ys Координаты источника
+*/
+typedef void (*CoordsFunc)(double X, double Y, double W, double dX, double dY, double dW, int n, float xlim, float ylim, int* xs, int* ys);
+
+void CoordsScalar(double X, double Y, double W, double dX, double dY, double dW, int n, float xlim, float ylim, int* xs, int* ys)
+{
+    for (int i = 0; i < n; i++) {
+        float fx = -2.0f, fy = -2.0f;
+        if (W != 0) {
+            double w = 1.0 / W;
+            fx = std::min(std::max((float)(X * w), -2.0f), xlim);
+            fy = std::min(std::max((float)(Y * w), -2.0f), ylim);
+        }
+        xs[i] = (int)std::lrint(fx * WARP_SCALE);
+        ys[i] = (int)std::lrint(fy * WARP_SCALE);
+        X += dX; Y += dY; W += dW;
+    }
+}
+
+#ifdef WARP_X86
+
+WARP_TARGET("sse4.1")
+void CoordsSSE41(double X, double Y, double W, double dX, double dY, double dW, int n, float xlim, float ylim, int* xs, int* ys)
+{
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 vdx = _mm_set1_ps((float)dX), vdy = _mm_set1_ps((float)dY), vdw = _mm_set1_ps((float)dW);
+    const __m128 lo = _mm_set1_ps(-2.0f), xhi = _mm_set1_ps(xlim), yhi = _mm_set1_ps(ylim);
+    const __m128 scale = _mm_set1_ps((float)WARP_SCALE), zero = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        //начало четверки считаем в double, чтобы ошибка не копилась вдоль строки, внутри четверки хватает float
+        __m128 x = _mm_add_ps(_mm_set1_ps((float)(X + dX * i)), _mm_mul_ps(lane, vdx));
+        __m128 y = _mm_add_ps(_mm_set1_ps((float)(Y + dY * i)), _mm_mul_ps(lane, vdy));
+        __m128 w = _mm_add_ps(_mm_set1_ps((float)(W + dW * i)), _mm_mul_ps(lane, vdw));
+
+        __m128 valid = _mm_cmpneq_ps(w, zero);
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), w);
+        x = _mm_blendv_ps(lo, _mm_min_ps(_mm_max_ps(_mm_mul_ps(x, inv), lo), xhi), valid);
+        y = _mm_blendv_ps(lo, _mm_min_ps(_mm_max_ps(_mm_mul_ps(y, inv), lo), yhi), valid);
+
+        _mm_storeu_si128((__m128i*)(xs + i), _mm_cvtps_epi32(_mm_mul_ps(x, scale)));
+        _mm_storeu_si128((__m128i*)(ys + i), _mm_cvtps_epi32(_mm_mul_ps(y, scale)));
+    }
+    CoordsScalar(X + dX * i, Y + dY * i, W + dW * i, dX, dY, dW, n - i, xlim, ylim, xs + i, ys + i);
+}
+
+WARP_TARGET("avx2")
+void CoordsAVX2(double X, double Y, double W, double dX, double dY, double dW, int n, float xlim, float ylim, int* xs, int* ys)
+{
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 vdx = _mm256_set1_ps((float)dX), vdy = _mm256_set1_ps((float)dY), vdw = _mm256_set1_ps((float)dW);
+    const __m256 lo = _mm256_set1_ps(-2.0f), xhi = _mm256_set1_ps(xlim), yhi = _mm256_set1_ps(ylim);
+    const __m256 scale = _mm256_set1_ps((float)WARP_SCALE), zero = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_add_ps(_mm256_set1_ps((float)(X + dX * i)), _mm256_mul_ps(lane, vdx));
+        __m256 y = _mm256_add_ps(_mm256_set1_ps((float)(Y + dY * i)), _mm256_mul_ps(lane, vdy));
+        __m256 w = _mm256_add_ps(_mm256_set1_ps((float)(W + dW * i)), _mm256_mul_ps(lane, vdw));
+
+        __m256 valid = _mm256_cmp_ps(w, zero, _CMP_NEQ_OQ);
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), w);
+        x = _mm256_blendv_ps(lo, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(x, inv), lo), xhi), valid);
+        y = _mm256_blendv_ps(lo, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(y, inv), lo), yhi), valid);
+
+        _mm256_storeu_si256((__m256i*)(xs + i), _mm256_cvtps_epi32(_mm256_mul_ps(x, scale)));
+        _mm256_storeu_si256((__m256i*)(ys + i), _mm256_cvtps_epi32(_mm256_mul_ps(y, scale)));
+    }
+    CoordsScalar(X + dX * i, Y + dY * i, W + dW * i, dX, dY, dW, n - i, xlim, ylim, xs + i, ys + i);
+}
+
+#endif
+
+/*!
+Выбирает самую быструю реализацию, которую поддерживает процессор
+\returns индекс ядра: 0 - scalar, 1 - sse4.1, 2 - avx2
+*/
+int DetectKernel()
+{
+#ifdef WARP_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (avx && max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    if (avx2) return 2;
+    if (sse41) return 1;
+#endif
+    return 0;
+}
+
+int Kernel()
+{
+    static const int kernel = DetectKernel();
+    return kernel;
+}
+
+CoordsFunc SelectCoords()
+{
+#ifdef WARP_X86
+    switch (Kernel()) {
+    case 2: return CoordsAVX2;
+    case 1: return CoordsSSE41;
+    }
+#endif
+    return CoordsScalar;
+}
+
+/*!
+Пиксель источника или nullptr, если он за границей
+*/
+template<int cn>
+inline const uchar* PixelOrNull(const Mat& src, int x, int y)
+{
+    if ((unsigned)x >= (unsigned)src.cols || (unsigned)y >= (unsigned)src.rows) return nullptr;
+    return src.ptr(y) + x * cn;
+}
+
+/*!
+Записывает смешанный пиксель источника с cn каналами в результат с dcn каналами
+*/
+template<int cn, int dcn>
+inline void StorePixel(uchar* dst, const int* v)
+{
+    if (cn == 3 && dcn == 1) dst[0] = (uchar)((v[0] * GRAY_B + v[1] * GRAY_G + v[2] * GRAY_R + (1 << (GRAY_BITS - 1))) >> GRAY_BITS);
+    else if (cn == 1) for (int k = 0; k < (dcn < 3 ? dcn : 3); k++) dst[k] = (uchar)v[0];
+    else for (int k = 0; k < 3; k++) dst[k] = (uchar)v[k];
+    if (dcn == 4) dst[3] = 255;
+}
+
+/*!
+Билинейно смешивает четыре соседних пикселя источника для n пикселей результата
+\param[in] src Источник с cn каналами
+\param[out] dst Первый пиксель результата с dcn каналами
+\param[in] xs,ys Координаты источника в фиксированной точке
+\param[in] n Количество пикселей
+*/
+template<int cn, int dcn>
+void BlendRow(const Mat& src, uchar* dst, const int* xs, const int* ys, int n)
+{
+    const int round = 1 << (WEIGHT_BITS - 1);
+    const size_t step = src.step;
+
+    for (int i = 0; i < n; i++, dst += dcn) {
+        int x = xs[i] >> WARP_BITS, y = ys[i] >> WARP_BITS;
+        int ax = xs[i] & (WARP_SCALE - 1), ay = ys[i] & (WARP_SCALE - 1);
+        int w00 = (WARP_SCALE - ax) * (WARP_SCALE - ay), w01 = ax * (WARP_SCALE - ay);
+        int w10 = (WARP_SCALE - ax) * ay, w11 = ax * ay;
+
+        //каналы сначала округляются до байта, как в результате warpPerspective, и только потом переводятся
+        int v[3];
+        if ((unsigned)x < (unsigned)(src.cols - 1) && (unsigned)y < (unsigned)(src.rows - 1)) {
+            //все четыре соседа внутри изображения, самый частый случай
+            const uchar* p0 = src.ptr(y) + x * cn;
+            const uchar* p1 = p0 + step;
+            for (int k = 0; k < cn; k++) {
+                v[k] = (p0[k] * w00 + p0[k + cn] * w01 + p1[k] * w10 + p1[k + cn] * w11 + round) >> WEIGHT_BITS;
+            }
+        }
+        else if (x < -1 || x >= src.cols || y < -1 || y >= src.rows) {
+            for (int k = 0; k < cn; k++) v[k] = 0;
+        }
+        else {
+            //край изображения: недостающие соседи черные
+            const uchar* p00 = PixelOrNull<cn>(src, x, y);
+            const uchar* p01 = PixelOrNull<cn>(src, x + 1, y);
+            const uchar* p10 = PixelOrNull<cn>(src, x, y + 1);
+            const uchar* p11 = PixelOrNull<cn>(src, x + 1, y + 1);
+            for (int k = 0; k < cn; k++) {
+                int sum = (p00 ? p00[k] * w00 : 0) + (p01 ? p01[k] * w01 : 0) + (p10 ? p10[k] * w10 : 0) + (p11 ? p11[k] * w11 : 0);
+                v[k] = (sum + round) >> WEIGHT_BITS;
+            }
+        }
+        StorePixel<cn, dcn>(dst, v);
+    }
+}
+
+typedef void (*BlendFunc)(const Mat& src, uchar* dst, const int* xs, const int* ys, int n);
+
+#ifdef WARP_X86
+
+/*!
+Билинейное смешивание на SSE4.1, четыре пикселя результата за шаг.
+Для каждого пикселя пара соседей строки раскладывается в 16-битные пары (левый, правый) по каналам,
+и _mm_madd_epi16 с парой весов (w00, w01) сразу дает сумму по строке; так же нижняя строка.
+Четверки, где хоть один пиксель у края или снаружи, и хвост строки уходят в BlendRow, поэтому результат совпадает с ним до бита
+*/
+template<int cn, int dcn>
+WARP_TARGET("sse4.1")
+void BlendRowSSE41(const Mat& src, uchar* dst, const int* xs, const int* ys, int n)
+{
+    const size_t step = src.step;
+    const uchar* data = src.data;
+
+    //из 8 байт строки (левый и правый сосед) 16-битные пары по каналам, лишние пары нулевые
+    const __m128i pairs = cn == 3 ? _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1)
+                                  : _mm_setr_epi8(0, -1, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i frac = _mm_set1_epi32(WARP_SCALE - 1), one = _mm_set1_epi32(WARP_SCALE);
+    const __m128i round = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+    const __m128i minus_one = _mm_set1_epi32(-1);
+    //восемь байт от левого соседа не выходят за строку, пока x <= cols - 3 (для серого хватает двух байт)
+    const __m128i xmax = _mm_set1_epi32(cn == 3 ? src.cols - 2 : src.cols - 1), ymax = _mm_set1_epi32(src.rows - 1);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+    const __m128i gray_weights = _mm_setr_epi16(GRAY_B, GRAY_G, GRAY_R, 0, GRAY_B, GRAY_G, GRAY_R, 0);
+    const __m128i gray_round = _mm_set1_epi32(1 << (GRAY_BITS - 1));
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i vx = _mm_loadu_si128((const __m128i*)(xs + i));
+        __m128i vy = _mm_loadu_si128((const __m128i*)(ys + i));
+        __m128i ix = _mm_srai_epi32(vx, WARP_BITS), iy = _mm_srai_epi32(vy, WARP_BITS);
+        __m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(xmax, ix), _mm_cmpgt_epi32(ix, minus_one)),
+                                       _mm_and_si128(_mm_cmpgt_epi32(ymax, iy), _mm_cmpgt_epi32(iy, minus_one)));
+        if (_mm_movemask_epi8(inside) != 0xFFFF) {
+            BlendRow<cn, dcn>(src, dst + i * dcn, xs + i, ys + i, 4);
+            continue;
+        }
+
+        //веса в парах (w00 | w01 << 16) и (w10 | w11 << 16), каждый не больше 1 << WEIGHT_BITS
+        __m128i ax = _mm_and_si128(vx, frac), ay = _mm_and_si128(vy, frac);
+        __m128i bx = _mm_sub_epi32(one, ax), by = _mm_sub_epi32(one, ay);
+        __m128i wtop = _mm_or_si128(_mm_mullo_epi32(bx, by), _mm_slli_epi32(_mm_mullo_epi32(ax, by), 16));
+        __m128i wbottom = _mm_or_si128(_mm_mullo_epi32(bx, ay), _mm_slli_epi32(_mm_mullo_epi32(ax, ay), 16));
+
+        alignas(16) int px[4], py[4], top[4], bottom[4];
+        _mm_store_si128((__m128i*)px, ix);
+        _mm_store_si128((__m128i*)py, iy);
+        _mm_store_si128((__m128i*)top, wtop);
+        _mm_store_si128((__m128i*)bottom, wbottom);
+
+        __m128i v[4];
+        for (int k = 0; k < 4; k++) {
+            const uchar* p0 = data + py[k] * step + px[k] * cn;
+            __m128i r0, r1;
+            if (cn == 3) {
+                r0 = _mm_loadl_epi64((const __m128i*)p0);
+                r1 = _mm_loadl_epi64((const __m128i*)(p0 + step));
+            }
+            else {
+                unsigned short a, b;
+                memcpy(&a, p0, 2);
+                memcpy(&b, p0 + step, 2);
+                r0 = _mm_cvtsi32_si128(a);
+                r1 = _mm_cvtsi32_si128(b);
+            }
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_shuffle_epi8(r0, pairs), _mm_set1_epi32(top[k])),
+                                        _mm_madd_epi16(_mm_shuffle_epi8(r1, pairs), _mm_set1_epi32(bottom[k])));
+            v[k] = _mm_srai_epi32(_mm_add_epi32(sum, round), WEIGHT_BITS);
+        }
+
+        //каналы округлены до байта, как в BlendRow: четыре пикселя по четыре 16-битных канала
+        __m128i v01 = _mm_packs_epi32(v[0], v[1]), v23 = _mm_packs_epi32(v[2], v[3]);
+        __m128i bytes = _mm_packus_epi16(v01, v23); //b g r 0 для цветного, v 0 0 0 для серого
+        uchar* out = dst + i * dcn;
+        if (cn == 3 && dcn == 4) _mm_storeu_si128((__m128i*)out, _mm_or_si128(bytes, alpha));
+        else if (cn == 3 && dcn == 3) {
+            __m128i packed = _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+            _mm_storel_epi64((__m128i*)out, packed);
+            int last = _mm_extract_epi32(packed, 2);
+            memcpy(out + 8, &last, 4);
+        }
+        else if (cn == 3 && dcn == 1) {
+            __m128i gray = _mm_hadd_epi32(_mm_madd_epi16(v01, gray_weights), _mm_madd_epi16(v23, gray_weights));
+            gray = _mm_srai_epi32(_mm_add_epi32(gray, gray_round), GRAY_BITS);
+            int packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(gray, gray), gray));
+            memcpy(out, &packed, 4);
+        }
+        else if (dcn == 1) {
+            int packed = _mm_cvtsi128_si32(_mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+            memcpy(out, &packed, 4);
+        }
+        else if (dcn == 3) {
+            __m128i packed = _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1));
+            _mm_storel_epi64((__m128i*)out, packed);
+            int last = _mm_extract_epi32(packed, 2);
+            memcpy(out + 8, &last, 4);
+        }
+        else {
+            __m128i spread = _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 0, 0, -1, 4, 4, 4, -1, 8, 8, 8, -1, 12, 12, 12, -1));
+            _mm_storeu_si128((__m128i*)out, _mm_or_si128(spread, alpha));
+        }
+    }
+    BlendRow<cn, dcn>(src, dst + i * dcn, xs + i, ys + i, n - i);
+}
+
+#endif
+
+/*!
+Смешивание для сочетания каналов источника и результата
+*/
+BlendFunc SelectBlend(int cn, int dcn)
+{
+#ifdef WARP_X86
+    //смешивание одно для SSE4.1 и AVX2: выборка соседей по одному пикселю, более широкие регистры ее не ускоряют
+    if (Kernel() >= 1) {
+        if (cn == 3) return dcn == 1 ? BlendRowSSE41<3, 1> : dcn == 4 ? BlendRowSSE41<3, 4> : BlendRowSSE41<3, 3>;
+        return dcn == 3 ? BlendRowSSE41<1, 3> : dcn == 4 ? BlendRowSSE41<1, 4> : BlendRowSSE41<1, 1>;
+    }
+#endif
+    if (cn == 3) return dcn == 1 ? BlendRow<3, 1> : dcn == 4 ? BlendRow<3, 4> : BlendRow<3, 3>;
+    return dcn == 3 ? BlendRow<1, 3> : dcn == 4 ? BlendRow<1, 4> : BlendRow<1, 1>;
+}
+
+/*!
+Количество каналов результата
+*/
+int LayoutChannels(WarpLayout layout, int cn)
+{
+    switch (layout) {
+    case WARP_LAYOUT_BGR: return 3;
+    case WARP_LAYOUT_BGRA: return 4;
+    case WARP_LAYOUT_GRAY: return 1;
+    default: return cn;
+    }
+}
+
+} // namespace
+
+const char* WarpKernelName()
+{
+    switch (Kernel()) {
+    case 2: return "avx2";
+    case 1: return "sse4.1";
+    }
+    return "scalar";
+}
+
+void ConvertToLayout(const Mat& src, Mat& dst, WarpLayout layout)
+{
+    int code = -1;
+    switch (LayoutChannels(layout, src.channels()) * 10 + src.channels()) {
+    case 13: code = COLOR_BGR2GRAY; break;
+    case 14: code = COLOR_BGRA2GRAY; break;
+    case 31: code = COLOR_GRAY2BGR; break;
+    case 34: code = COLOR_BGRA2BGR; break;
+    case 41: code = COLOR_GRAY2BGRA; break;
+    case 43: code = COLOR_BGR2BGRA; break;
+    }
+    if (code >= 0) cvtColor(src, dst, code);
+    else if (dst.data != src.data) dst = src;
+}
+
+void WarpPerspectiveBilinear(const Mat& src, Mat& dst, const Matx33d& M, Size dsize, WarpLayout layout)
+{
+    if (src.empty() || src.depth() != CV_8U || (src.channels() != 1 && src.channels() != 3)) {
+        warpPerspective(src, dst, Mat(M), dsize);
+        ConvertToLayout(dst, dst, layout);
+        return;
+    }
+
+    //результат пишется построчно, поэтому источник не должен совпадать с ним
+    Mat source = src.data == dst.data ? src.clone() : src;
+
+    //обратная матрица переводит пиксель результата в точку источника
+    Matx33d m = M.inv();
+
+    const int cn = source.channels();
+    const int dcn = LayoutChannels(layout, cn);
+    dst.create(dsize, CV_8UC(dcn));
+
+    const CoordsFunc coords = SelectCoords();
+    const BlendFunc blend = SelectBlend(cn, dcn);
+    const float xlim = (float)source.cols + 1;
+    const float ylim = (float)source.rows + 1;
+
+    parallel_for_(Range(0, dsize.height), [&](const Range& range) {
+        int xs[BLOCK], ys[BLOCK];
+        for (int y = range.start; y < range.end; y++) {
+            uchar* out = dst.ptr(y);
+
+            //однородные координаты первого пикселя строки, дальше только приращения m(.,0)
+            double X = m(0, 1) * y + m(0, 2);
+            double Y = m(1, 1) * y + m(1, 2);
+            double W = m(2, 1) * y + m(2, 2);
+
+            for (int x = 0; x < dsize.width; x += BLOCK) {
+                int n = std::min(BLOCK, dsize.width - x);
+                coords(X + m(0, 0) * x, Y + m(1, 0) * x, W + m(2, 0) * x, m(0, 0), m(1, 0), m(2, 0), n, xlim, ylim, xs, ys);
+                blend(source, out + x * dcn, xs, ys, n);
+            }
+        }
+    });
+}
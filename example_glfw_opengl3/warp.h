@@ -0,0 +1,54 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+/*!
+Чем выполнять исправление перспективы
+*/
+enum WarpBackend
+{
+    WARP_OPENCV = 0, //!<cv::warpPerspective
+    WARP_SIMD //!<собственное билинейное ядро на SSE4.1/AVX2 для 8-битных BGR и серых изображений
+};
+
+/*!
+В каком виде писать результат исправления
+*/
+enum WarpLayout
+{
+    WARP_LAYOUT_SOURCE = 0, //!<как у источника
+    WARP_LAYOUT_BGR, //!<BGR для imwrite и кодировщиков
+    WARP_LAYOUT_BGRA, //!<BGRA с альфой 255: строки кратны 4 байтам и сразу загружаются в текстуру GL_RGBA8
+    WARP_LAYOUT_GRAY //!<один канал яркости для документов, те же веса, что у cv::COLOR_BGR2GRAY
+};
+
+/*!
+Переводит изображение в нужный вид через cv::cvtColor, для ядер, которые сами не умеют писать в другом виде
+\param[in] src 8-битное изображение с 1, 3 или 4 каналами
+\param[out] dst Результат, может совпадать с src
+\param[in] layout Нужный вид, при совпадении с src данные не копируются
+*/
+void ConvertToLayout(const cv::Mat& src, cv::Mat& dst, WarpLayout layout);
+
+/*!
+Билинейное проективное преобразование 8-битного BGR или серого изображения.
+Координаты источника считаются приращениями вдоль строки результата, деление на w и
+вычисление весов выполняются векторно (AVX2 или SSE4.1, выбирается при запуске по возможностям процессора),
+смешивание четырех соседей - по четыре пикселя за раз через _mm_madd_epi16, пиксели у края источника считаются по одному.
+Пиксели за границей источника считаются черными, как у cv::warpPerspective по умолчанию.
+Результат сразу пишется в нужном виде (BGRA для текстуры, серый, BGR), без промежуточного буфера и второго прохода cvtColor;
+пиксели совпадают с cvtColor от результата в виде источника.
+Остальные типы изображений передаются в cv::warpPerspective и затем в ConvertToLayout.
+\param[in] src Исходное изображение
+\param[out] dst Результат размера dsize
+\param[in] M Матрица преобразования источника в результат (как у cv::warpPerspective)
+\param[in] dsize Размер результата
+\param[in] layout В каком виде писать результат
+*/
+void WarpPerspectiveBilinear(const cv::Mat& src, cv::Mat& dst, const cv::Matx33d& M, cv::Size dsize, WarpLayout layout = WARP_LAYOUT_SOURCE);
+
+/*!
+Возвращает имя ядра, которое выбрал WarpPerspectiveBilinear на этом процессоре
+\returns "avx2", "sse4.1" или "scalar"
+*/
+const char* WarpKernelName();
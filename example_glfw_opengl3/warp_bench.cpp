@@ -0,0 +1,85 @@
+// Сравнение cv::warpPerspective с собственным ядром WarpPerspectiveBilinear на синтетическом изображении.
+// Запуск: warp_bench [мегапиксели источника] [повторы]
+
+#include "warp.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace cv;
+
+/*!
+Среднее время одного вызова в миллисекундах
+*/
+template<typename F>
+static double TimeMs(int repeats, F body)
+{
+    body(); //прогрев: выделение результата и кэши
+    auto started = chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) body();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() / repeats;
+}
+
+int main(int argc, char** argv)
+{
+    double megapixels = argc > 1 ? atof(argv[1]) : 12;
+    int repeats = argc > 2 ? atoi(argv[2]) : 20;
+
+    int width = (int)sqrt(megapixels * 1e6 * 4 / 3);
+    int height = width * 3 / 4;
+
+    Mat bgr(height, width, CV_8UC3);
+    randu(bgr, Scalar::all(0), Scalar::all(255));
+    Mat gray(height, width, CV_8UC1);
+    randu(gray, Scalar::all(0), Scalar::all(255));
+
+    //четырехугольник, похожий на сфотографированный под углом лист
+    Point2f quad[4] = { Point2f(width * 0.12f, height * 0.08f), Point2f(width * 0.91f, height * 0.15f),
+                        Point2f(width * 0.05f, height * 0.93f), Point2f(width * 0.86f, height * 0.97f) };
+
+    printf("source %dx%d, kernel %s, %d repeats\n", width, height, WarpKernelName(), repeats);
+    printf("%-6s %-11s %12s %12s %8s %8s\n", "type", "output", "opencv ms", "simd ms", "speedup", "maxdiff");
+
+    int sizes[] = { 500, 1000, 2000, 4000 };
+    for (int size : sizes) {
+        Point2f border[4] = { Point2f(0, 0), Point2f((float)size, 0), Point2f(0, (float)size), Point2f((float)size, (float)size) };
+        Mat transform = getPerspectiveTransform(quad, border);
+
+        const Mat* sources[] = { &bgr, &gray };
+        for (const Mat* src : sources) {
+            Mat reference, result;
+            double opencv_ms = TimeMs(repeats, [&]() { warpPerspective(*src, reference, transform, Size(size, size)); });
+            double simd_ms = TimeMs(repeats, [&]() { WarpPerspectiveBilinear(*src, result, Matx33d(transform), Size(size, size)); });
+
+            printf("%-6s %5dx%-5d %12.2f %12.2f %7.2fx %8.0f\n", src->channels() == 3 ? "bgr" : "gray", size, size,
+                opencv_ms, simd_ms, opencv_ms / simd_ms, norm(reference, result, NORM_INF));
+        }
+    }
+
+    //запись результата сразу в нужном виде против исправления и отдельного cvtColor, результат должен совпасть до бита
+    printf("\n%-6s %-11s %12s %12s %8s %8s\n", "layout", "output", "2-pass ms", "fused ms", "speedup", "maxdiff");
+    const WarpLayout layouts[] = { WARP_LAYOUT_BGRA, WARP_LAYOUT_GRAY };
+    for (int size : sizes) {
+        Point2f border[4] = { Point2f(0, 0), Point2f((float)size, 0), Point2f(0, (float)size), Point2f((float)size, (float)size) };
+        Matx33d transform(getPerspectiveTransform(quad, border));
+
+        for (WarpLayout layout : layouts) {
+            Mat warped, reference, result;
+            double two_pass_ms = TimeMs(repeats, [&]() {
+                WarpPerspectiveBilinear(bgr, warped, transform, Size(size, size));
+                ConvertToLayout(warped, reference, layout);
+            });
+            double fused_ms = TimeMs(repeats, [&]() { WarpPerspectiveBilinear(bgr, result, transform, Size(size, size), layout); });
+
+            printf("%-6s %5dx%-5d %12.2f %12.2f %7.2fx %8.0f\n", layout == WARP_LAYOUT_BGRA ? "bgra" : "gray", size, size,
+                two_pass_ms, fused_ms, two_pass_ms / fused_ms, norm(reference, result, NORM_INF));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include "watch.h"
+#include "batch.h"
+#include "bounded_queue.h"
+#include "mapped_file.h"
+
+#include <opencv2/core/utils/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+const char* CORNERS_SUFFIX = ".corners";
+
+bool ReadCorners(const string& path, Point2f corners[4])
+{
+    ifstream file(path);
+    for (int i = 0; i < 4; i++) {
+        file >> corners[i].x >> corners[i].y;
+    }
+    return !file.fail();
+}
+
+#ifdef __linux__
+
+static volatile sig_atomic_t stop_requested = 0; //!<пришел SIGINT или SIGTERM
+
+static void OnStopSignal(int)
+{
+    stop_requested = 1;
+}
+
+static bool EndsWith(const string& text, const string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/*!
+Размер и время изменения файла: если они не меняются между просмотрами папки, запись закончена
+*/
+struct FileStamp
+{
+    off_t size = -1;
+    timespec modified = timespec();
+
+    bool operator==(const FileStamp& other) const
+    {
+        return size == other.size && modified.tv_sec == other.modified.tv_sec && modified.tv_nsec == other.modified.tv_nsec;
+    }
+};
+
+static bool ReadStamp(const string& path, FileStamp& stamp)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    stamp.size = info.st_size;
+    stamp.modified = info.st_mtim;
+    return true;
+}
+
+/*!
+Изображение с углами, найденное просмотром папки
+*/
+struct ScanCandidate
+{
+    FileStamp image; //!<изображение при последнем просмотре
+    FileStamp corners; //!<файл углов при последнем просмотре
+    bool queued = false; //!<уже поставлено в очередь, повторно не ставим, пока файлы не изменятся
+};
+
+int RunWatch(const char* input, const char* output, const PerspectiveSolver& solver, int threads, size_t depth, const SaveOptions& encoding)
+{
+    string in(input);
+    string out(output);
+    if (!utils::fs::isDirectory(in) || !utils::fs::isDirectory(out)) {
+        cerr << "Both " << in << " and " << out << " must be existing directories" << endl;
+        return 1;
+    }
+
+    int inotify = inotify_init1(IN_CLOEXEC);
+    if (inotify < 0 || inotify_add_watch(inotify, in.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+        cerr << "Failed to watch " << in << endl;
+        if (inotify >= 0) close(inotify);
+        return 1;
+    }
+
+    if (threads <= 0) threads = (int)thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    //параллелим по изображениям, как в пакетном режиме
+    setNumThreads(1);
+
+    BoundedQueue<BatchJob> jobs(depth);
+    atomic<int> done(0);
+    atomic<int> failed(0);
+    mutex log_mutex;
+    set<string> active; //!<входные файлы в очереди и в работе, просмотр папки их пропускает
+    mutex active_mutex;
+
+    auto worker = [&]() {
+        BatchJob job;
+        while (jobs.Pop(job)) {
+            auto started = chrono::steady_clock::now();
+            //файл читаем копией, а не отображением: его могут переписать или укоротить прямо во время
+            //обработки, и обращение к отображению пропавшего хвоста завершило бы службу сигналом SIGBUS
+            Mat bytes, image, result;
+            Point origin;
+            WarpPlan plan;
+            SolverStatus status = solver.Plan(job.corners, plan);
+            if (status == SOLVER_OK && !ReadFileBytes(job.input, bytes)) status = SOLVER_DECODE_FAILED;
+            if (status == SOLVER_OK) status = solver.DecodeRegion(bytes, job.corners, image, origin);
+            if (status == SOLVER_OK) status = solver.Warp(image, OffsetPlan(plan, origin), result);
+            bytes.release();
+            image.release();
+
+            //формат по расширению результата, как в пакетном режиме, настройки из --encode
+            SaveOptions options = encoding;
+            EncodeStats stats;
+            bool known = SaveFormatFromPath(job.output, options.format);
+            if (status == SOLVER_OK) status = known ? SaveImage(job.output, result, options, stats) : solver.Save(job.output, result);
+            result.release();
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            {
+                lock_guard<mutex> lock(active_mutex);
+                active.erase(job.input);
+            }
+
+            lock_guard<mutex> lock(log_mutex);
+            if (status == SOLVER_OK) {
+                done++;
+                cout << job.input << " -> " << job.output << " in " << (int)ms << " ms" << endl;
+            }
+            else {
+                failed++;
+                cerr << job.input << ": " << SolverStatusText(status) << endl;
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (int i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+
+    set<string> ready; //!<файлы, запись которых закончена, но пара к ним еще не пришла. Только файлы, которые еще лежат в папке
+    map<string, ScanCandidate> candidates; //!<изображения без результата из последнего просмотра папки
+    bool settling = false; //!<при просмотре часть файлов еще менялась, папку надо просмотреть снова
+
+    //файл готов: если у изображения теперь есть и углы, ставим его в очередь
+    auto arrived = [&](const string& name) {
+        ready.insert(name);
+        string image = EndsWith(name, CORNERS_SUFFIX) ? name.substr(0, name.size() - strlen(CORNERS_SUFFIX)) : name;
+        string corners = image + CORNERS_SUFFIX;
+        if (image.empty() || !ready.count(image) || !ready.count(corners)) return;
+
+        //пара собрана, дальше имена не нужны. Непарные имена набор держит, пока файл лежит в папке:
+        //их убирают события удаления и переноса и просмотр папки, так что набор не больше самой папки
+        ready.erase(image);
+        ready.erase(corners);
+        auto candidate = candidates.find(image);
+        if (candidate != candidates.end()) candidate->second.queued = true;
+
+        BatchJob job;
+        job.input = in + "/" + image;
+        job.output = out + "/" + image;
+        if (!ReadCorners(in + "/" + corners, job.corners)) {
+            failed++;
+            lock_guard<mutex> lock(log_mutex);
+            cerr << in << "/" << corners << ": expected \"x1 y1 x2 y2 x3 y3 x4 y4\"" << endl;
+            return;
+        }
+        {
+            lock_guard<mutex> lock(active_mutex);
+            active.insert(job.input);
+        }
+        //ждет, пока в очереди освободится место, новые события тем временем копятся в inotify
+        jobs.Push(job);
+    };
+
+    //просмотр папки при запуске и после потери событий. Не переделываем то, для чего есть результат или что уже в работе.
+    //Событий закрытия файла здесь нет, поэтому файл принимаем, только если его размер и время изменения
+    //не поменялись с прошлого просмотра: иначе его, возможно, еще пишут
+    auto scan = [&]() {
+        vector<string> files;
+        utils::fs::glob(in, "*", files);
+        set<string> present;
+        for (const string& path : files) {
+            present.insert(path.substr(path.find_last_of("\\/") + 1));
+        }
+        //события удаления могли потеряться вместе с остальными: забываем файлы, которых уже нет
+        for (auto name = ready.begin(); name != ready.end(); ) {
+            if (present.count(*name)) ++name;
+            else name = ready.erase(name);
+        }
+
+        files.clear();
+        utils::fs::glob(in, "*" + string(CORNERS_SUFFIX), files);
+        sort(files.begin(), files.end());
+        map<string, ScanCandidate> seen;
+        settling = false;
+        for (const string& path : files) {
+            string name = path.substr(path.find_last_of("\\/") + 1);
+            string image = name.substr(0, name.size() - strlen(CORNERS_SUFFIX));
+            if (utils::fs::exists(out + "/" + image)) continue;
+            {
+                lock_guard<mutex> lock(active_mutex);
+                if (active.count(in + "/" + image)) continue;
+            }
+
+            ScanCandidate candidate;
+            if (!ReadStamp(in + "/" + image, candidate.image) || !ReadStamp(path, candidate.corners)) continue;
+            auto previous = candidates.find(image);
+            bool settled = previous != candidates.end() && previous->second.image == candidate.image && previous->second.corners == candidate.corners;
+            candidate.queued = settled && previous->second.queued;
+            seen[image] = candidate;
+            if (!settled) settling = true;
+            else if (!candidate.queued) {
+                seen[image].queued = true;
+                ready.insert(image);
+                arrived(name);
+            }
+        }
+        candidates.swap(seen);
+    };
+
+    signal(SIGINT, OnStopSignal);
+    signal(SIGTERM, OnStopSignal);
+
+    cout << "Watching " << in << " on " << threads << " threads, Ctrl+C to stop" << endl;
+    scan();
+
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (!stop_requested) {
+        pollfd descriptor = { inotify, POLLIN, 0 };
+        int polled = poll(&descriptor, 1, 500);
+        if (polled <= 0) {
+            //таймаут или сигнал: проверяем флаг остановки и досматриваем файлы, которые еще менялись
+            if (polled == 0 && settling) scan();
+            continue;
+        }
+
+        ssize_t length = read(inotify, buffer, sizeof(buffer));
+        for (char* ptr = buffer; length > 0 && ptr < buffer + length; ) {
+            const inotify_event* event = (const inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+
+            //очередь событий ядра переполнилась: часть событий потеряна, пересматриваем папку
+            if (event->mask & IN_Q_OVERFLOW) scan();
+            else if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) ready.erase(event->name);
+            else arrived(event->name);
+        }
+    }
+
+    //дорабатываем принятые задания
+    jobs.Close();
+    for (thread& t : pool) {
+        t.join();
+    }
+    close(inotify);
+
+    cout << done << " images done, " << failed << " failed" << endl;
+    return failed == 0 ? 0 : 2;
+}
+
+#else
+
+int RunWatch(const char* input, const char* output, const PerspectiveSolver& solver, int threads, size_t depth, const SaveOptions& encoding)
+{
+    cerr << "Watch mode needs inotify and is available only on Linux" << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include "encoders.h"
+#include "solver.h"
+
+/*!
+Расширение файла с углами, который кладется рядом с изображением: для scan.jpg это scan.jpg.corners
+*/
+extern const char* CORNERS_SUFFIX;
+
+/*!
+Читает углы из файла: восемь чисел "x1 y1 x2 y2 x3 y3 x4 y4" через пробелы или переводы строк
+\param[in] path Путь до файла с углами
+\param[out] corners Углы в порядке файла
+\returns получилось ли прочитать все восемь чисел
+*/
+bool ReadCorners(const std::string& path, cv::Point2f corners[4]);
+
+/*!
+Следит за папкой и исправляет каждое изображение, рядом с которым появился файл углов.
+Файл считается готовым только после закрытия записи или переименования в папку (inotify IN_CLOSE_WRITE/IN_MOVED_TO),
+поэтому недописанные файлы не читаются. Изображения обрабатываются в порядке готовности пары "изображение + углы"
+пулом потоков; очередь ограничена, поэтому одновременно в памяти не больше threads изображений.
+При запуске и после переполнения очереди событий обрабатываются лежащие в папке пары, для которых еще нет результата
+и которые не в работе; событий закрытия для них нет, поэтому пара принимается, когда размер и время изменения обоих файлов
+не меняются между двумя просмотрами папки.
+Работает до SIGINT/SIGTERM, затем дорабатывает принятые задания. Доступно только в Linux.
+\param[in] input Папка, за которой следить
+\param[in] output Папка для результатов, имя файла сохраняется
+\param[in] solver Движок с выбранными ядром и геометрией результата
+\param[in] threads Количество рабочих потоков, 0 - по числу ядер
+\param[in] depth Сколько готовых пар может ждать свободного потока
+\param[in] encoding Настройки кодировщиков, формат результата все равно определяется расширением, как в пакетном режиме
+\returns код возврата процесса
+*/
+int RunWatch(const char* input, const char* output, const PerspectiveSolver& solver, int threads = 0, size_t depth = 4,
+    const SaveOptions& encoding = SaveOptions());
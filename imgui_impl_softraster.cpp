@@ -0,0 +1,522 @@
+// dear imgui: Renderer for a CPU software rasterizer
+// Renders ImDrawData into a caller-owned RGBA8 buffer without any graphics API.
+// Useful for headless screenshot tests, where no window or OpenGL context exists.
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..) or none at all for headless use.
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'ImGui_ImplSoftRaster_Texture*' as void*/ImTextureID. Read the FAQ about ImTextureID!
+//  [X] Renderer: Support for large meshes (64k+ vertices) with 16-bit indices.
+//  [X] Renderer: Scissor rectangles, alpha blending (SRC_ALPHA, ONE_MINUS_SRC_ALPHA), nearest texture sampling.
+//  [X] Renderer: Tile-parallel rasterization on worker threads, SSE2 span filling for solid-color triangles.
+// Missing features:
+//  [ ] Renderer: User callbacks are skipped (they usually issue graphics API calls), except ImDrawCallback_ResetRenderState which needs no work.
+
+// You can copy and use unmodified imgui_impl_* files in your project. See example_glfw_opengl3/softraster_shot.cpp for an example of using this.
+// If you are new to dear imgui, read examples/README.txt and read the documentation at the top of imgui.cpp.
+// https://github.com/ocornut/imgui
+
+// How it works:
+//  1. Every triangle of every draw command is set up once: edge functions, attribute gradients, bounding box clipped to the scissor rectangle.
+//  2. Triangles are binned into TILE_SIZE x TILE_SIZE screen tiles, keeping submission order inside each tile.
+//  3. Tiles are rasterized in parallel by the caller and a pool of worker threads started once in Init.
+//     Tiles never overlap, so no locking is needed and blending order is preserved.
+//  4. Each triangle row is reduced to one [x0, x1) span. Solid-color triangles (the vast majority of ImGui geometry:
+//     window backgrounds, frames, anti-aliased fringes with equal colors) are filled with a SIMD blend of a constant color.
+//     Textured or gradient triangles interpolate UV and color per pixel.
+//  Pixel centers are at (x + 0.5, y + 0.5) and shared edges follow a top-left style ownership rule, so the two
+//  triangles of a translucent rectangle do not blend their common diagonal twice.
+
+#include "imgui.h"
+#include "imgui_impl_softraster.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMGUI_IMPL_SOFTRASTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef IMGUI_USE_BGRA_PACKED_COLOR
+#error "imgui_impl_softraster expects the default RGBA packed vertex colors"
+#endif
+
+// Triangle prepared for rasterization
+struct ImGui_ImplSoftRaster_Triangle
+{
+    float   A[3], B[3], C[3];           // Edge functions w_i = A*x + B*y + C, positive inside. w_i is opposite to vertex i.
+    bool    Owns[3];                    // Edge owns pixels exactly on it (w_i == 0)
+    float   InvArea;
+    float   U0, V0, DU1, DV1, DU2, DV2; // UV at vertex 0 and its change along barycentrics 1 and 2
+    float   Col0[4], DCol1[4], DCol2[4];// Same for the color, 0..255
+    unsigned char Flat[4];              // Final color when Solid
+    bool    Solid;                      // Same color and UV at all vertices
+    const ImGui_ImplSoftRaster_Texture* Texture;
+    int     X0, Y0, X1, Y1;             // Bounding box clipped to the scissor rectangle, [X0, X1) x [Y0, Y1)
+};
+
+// Tiles of one frame, shared by the calling thread and the workers
+struct ImGui_ImplSoftRaster_Frame
+{
+    unsigned char*      Pixels;
+    int                 Width, Height, Stride;
+    int                 TilesX, TileCount;
+    std::atomic<int>    NextTile;
+};
+
+static const int                                TILE_SIZE = 64;
+static int                                      g_Threads = 1;
+static double                                   g_LastFrameTime = 0.0;
+static ImGui_ImplSoftRaster_Texture             g_FontTexture = { NULL, 0, 0, 0 };
+static std::vector<ImGui_ImplSoftRaster_Triangle> g_Triangles;
+static std::vector<int>                         g_BinOffsets;   // Start of each tile in g_BinTriangles, plus one past the end
+static std::vector<int>                         g_BinTriangles; // Triangle indices, grouped by tile, in submission order
+
+// Worker pool: started by Init, joined by Shutdown. Each frame bumps g_PoolGeneration and waits until g_PoolBusy drops to 0.
+static std::vector<std::thread>                 g_PoolThreads;
+static std::mutex                               g_PoolMutex;
+static std::condition_variable                  g_PoolWake;     // New frame or shutdown
+static std::condition_variable                  g_PoolIdle;     // Last worker finished the frame
+static ImGui_ImplSoftRaster_Frame*              g_PoolFrame = NULL;
+static unsigned int                             g_PoolGeneration = 0;
+static int                                      g_PoolBusy = 0;
+static bool                                     g_PoolQuit = false;
+
+static void ImGui_ImplSoftRaster_DrawTriangle(const ImGui_ImplSoftRaster_Triangle& t, unsigned char* pixels, int stride, int x0, int y0, int x1, int y1);
+
+// Rasterize tiles until none are left, each tile is owned by exactly one thread
+static void ImGui_ImplSoftRaster_DrawTiles(ImGui_ImplSoftRaster_Frame& frame)
+{
+    for (int tile = frame.NextTile++; tile < frame.TileCount; tile = frame.NextTile++)
+    {
+        int x0 = (tile % frame.TilesX) * TILE_SIZE;
+        int y0 = (tile / frame.TilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, frame.Width);
+        int y1 = std::min(y0 + TILE_SIZE, frame.Height);
+        for (int i = g_BinOffsets[tile]; i < g_BinOffsets[tile + 1]; i++)
+            ImGui_ImplSoftRaster_DrawTriangle(g_Triangles[g_BinTriangles[i]], frame.Pixels, frame.Stride, x0, y0, x1, y1);
+    }
+}
+
+static void ImGui_ImplSoftRaster_WorkerMain()
+{
+    unsigned int seen = 0;
+    for (;;)
+    {
+        ImGui_ImplSoftRaster_Frame* frame;
+        {
+            std::unique_lock<std::mutex> lock(g_PoolMutex);
+            g_PoolWake.wait(lock, [&]() { return g_PoolQuit || g_PoolGeneration != seen; });
+            if (g_PoolQuit)
+                return;
+            seen = g_PoolGeneration;
+            frame = g_PoolFrame;
+        }
+        ImGui_ImplSoftRaster_DrawTiles(*frame);
+        std::lock_guard<std::mutex> lock(g_PoolMutex);
+        if (--g_PoolBusy == 0)
+            g_PoolIdle.notify_one();
+    }
+}
+
+static void ImGui_ImplSoftRaster_StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_PoolMutex);
+        g_PoolQuit = true;
+    }
+    g_PoolWake.notify_all();
+    for (size_t i = 0; i < g_PoolThreads.size(); i++)
+        g_PoolThreads[i].join();
+    g_PoolThreads.clear();
+    g_PoolQuit = false;
+}
+
+// Functions
+bool    ImGui_ImplSoftRaster_Init(int threads)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "imgui_impl_softraster";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;  // We can honor the ImDrawCmd::VtxOffset field, allowing for large meshes.
+
+    if (threads <= 0)
+        threads = (int)std::thread::hardware_concurrency();
+    g_Threads = threads > 0 ? threads : 1;
+
+    // The calling thread rasterizes too, so the pool has one thread less
+    ImGui_ImplSoftRaster_StopWorkers();
+    for (int i = 1; i < g_Threads; i++)
+        g_PoolThreads.push_back(std::thread(ImGui_ImplSoftRaster_WorkerMain));
+    return true;
+}
+
+void    ImGui_ImplSoftRaster_Shutdown()
+{
+    ImGui_ImplSoftRaster_StopWorkers();
+    ImGui_ImplSoftRaster_DestroyFontsTexture();
+    g_Triangles.clear();
+    g_BinOffsets.clear();
+    g_BinTriangles.clear();
+}
+
+void    ImGui_ImplSoftRaster_NewFrame()
+{
+    if (!g_FontTexture.Pixels)
+        ImGui_ImplSoftRaster_CreateFontsTexture();
+}
+
+double  ImGui_ImplSoftRaster_GetLastFrameTime()
+{
+    return g_LastFrameTime;
+}
+
+bool    ImGui_ImplSoftRaster_CreateFontsTexture()
+{
+    // The atlas keeps ownership of the pixels, we only point at them.
+    ImGuiIO& io = ImGui::GetIO();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    g_FontTexture.Pixels = pixels;
+    g_FontTexture.Width = width;
+    g_FontTexture.Height = height;
+    g_FontTexture.Stride = width * 4;
+    io.Fonts->TexID = (ImTextureID)&g_FontTexture;
+    return true;
+}
+
+void    ImGui_ImplSoftRaster_DestroyFontsTexture()
+{
+    if (g_FontTexture.Pixels)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        io.Fonts->TexID = 0;
+        g_FontTexture.Pixels = NULL;
+    }
+}
+
+// Exact x/255 with rounding for x in [0, 255*255]
+static inline unsigned int ImGui_ImplSoftRaster_Div255(unsigned int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// dst = src * a + dst * (1 - a) for every channel including alpha, like glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+static inline void ImGui_ImplSoftRaster_BlendPixel(unsigned char* dst, unsigned int r, unsigned int g, unsigned int b, unsigned int a)
+{
+    if (a == 0)
+        return;
+    if (a == 255)
+    {
+        dst[0] = (unsigned char)r; dst[1] = (unsigned char)g; dst[2] = (unsigned char)b; dst[3] = 255;
+        return;
+    }
+    unsigned int ia = 255 - a;
+    dst[0] = (unsigned char)ImGui_ImplSoftRaster_Div255(r * a + dst[0] * ia);
+    dst[1] = (unsigned char)ImGui_ImplSoftRaster_Div255(g * a + dst[1] * ia);
+    dst[2] = (unsigned char)ImGui_ImplSoftRaster_Div255(b * a + dst[2] * ia);
+    dst[3] = (unsigned char)ImGui_ImplSoftRaster_Div255(a * a + dst[3] * ia);
+}
+
+// Blend one constant color over 'count' consecutive pixels
+static void ImGui_ImplSoftRaster_FillSpan(unsigned char* dst, int count, const unsigned char color[4])
+{
+    unsigned int a = color[3];
+    if (a == 0)
+        return;
+    int x = 0;
+#ifdef IMGUI_IMPL_SOFTRASTER_SSE2
+    if (a == 255)
+    {
+        unsigned int packed;
+        memcpy(&packed, color, 4);
+        __m128i fill = _mm_set1_epi32((int)packed);
+        for (; x + 4 <= count; x += 4)
+            _mm_storeu_si128((__m128i*)(dst + x * 4), fill);
+    }
+    else
+    {
+        // Two pixels per 128-bit half in 16-bit lanes; every intermediate stays below 65536.
+        __m128i zero = _mm_setzero_si128();
+        __m128i src = _mm_setr_epi16((short)(color[0] * a), (short)(color[1] * a), (short)(color[2] * a), (short)(a * a),
+                                     (short)(color[0] * a), (short)(color[1] * a), (short)(color[2] * a), (short)(a * a));
+        __m128i inv = _mm_set1_epi16((short)(255 - a));
+        __m128i half = _mm_set1_epi16(128);
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + x * 4));
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv), src), half);
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv), src), half);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+    for (; x < count; x++)
+        ImGui_ImplSoftRaster_BlendPixel(dst + x * 4, color[0], color[1], color[2], a);
+}
+
+static inline void ImGui_ImplSoftRaster_Sample(const ImGui_ImplSoftRaster_Texture* tex, float u, float v, unsigned char out[4])
+{
+    if (!tex || !tex->Pixels)
+    {
+        out[0] = out[1] = out[2] = out[3] = 255;
+        return;
+    }
+    int x = (int)(u * tex->Width);
+    int y = (int)(v * tex->Height);
+    x = x < 0 ? 0 : x >= tex->Width ? tex->Width - 1 : x;
+    y = y < 0 ? 0 : y >= tex->Height ? tex->Height - 1 : y;
+    memcpy(out, tex->Pixels + (size_t)y * tex->Stride + x * 4, 4);
+}
+
+static inline bool ImGui_ImplSoftRaster_Inside(const ImGui_ImplSoftRaster_Triangle& t, int e, float w)
+{
+    return w > 0.0f || (w == 0.0f && t.Owns[e]);
+}
+
+static inline bool ImGui_ImplSoftRaster_InsideAll(const ImGui_ImplSoftRaster_Triangle& t, float px, float py)
+{
+    for (int e = 0; e < 3; e++)
+        if (!ImGui_ImplSoftRaster_Inside(t, e, t.A[e] * px + t.B[e] * py + t.C[e]))
+            return false;
+    return true;
+}
+
+// Prepare one triangle, returns false if it covers no pixel
+static bool ImGui_ImplSoftRaster_Setup(ImGui_ImplSoftRaster_Triangle& t, const ImDrawVert* v[3], const ImVec2& offset, const ImVec2& scale,
+                                       int clip_x0, int clip_y0, int clip_x1, int clip_y1, const ImGui_ImplSoftRaster_Texture* texture)
+{
+    ImVec2 p[3];
+    for (int i = 0; i < 3; i++)
+        p[i] = ImVec2((v[i]->pos.x - offset.x) * scale.x, (v[i]->pos.y - offset.y) * scale.y);
+
+    // Edge i goes from vertex i+1 to vertex i+2, so w_i is zero at both and proportional to the distance from vertex i
+    float area = 0.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        const ImVec2& a = p[(i + 1) % 3];
+        const ImVec2& b = p[(i + 2) % 3];
+        t.A[i] = -(b.y - a.y);
+        t.B[i] = b.x - a.x;
+        t.C[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+    }
+    area = t.A[0] * p[0].x + t.B[0] * p[0].y + t.C[0];
+    if (area == 0.0f)
+        return false;
+    if (area < 0.0f)
+    {
+        // ImGui emits both windings, normalize so inside is always positive
+        for (int i = 0; i < 3; i++)
+        {
+            t.A[i] = -t.A[i]; t.B[i] = -t.B[i]; t.C[i] = -t.C[i];
+        }
+        area = -area;
+    }
+    for (int i = 0; i < 3; i++)
+        t.Owns[i] = t.A[i] > 0.0f || (t.A[i] == 0.0f && t.B[i] > 0.0f);
+    t.InvArea = 1.0f / area;
+
+    float min_x = std::min(p[0].x, std::min(p[1].x, p[2].x)), max_x = std::max(p[0].x, std::max(p[1].x, p[2].x));
+    float min_y = std::min(p[0].y, std::min(p[1].y, p[2].y)), max_y = std::max(p[0].y, std::max(p[1].y, p[2].y));
+    t.X0 = std::max(clip_x0, (int)floorf(min_x));
+    t.Y0 = std::max(clip_y0, (int)floorf(min_y));
+    t.X1 = std::min(clip_x1, (int)ceilf(max_x) + 1);
+    t.Y1 = std::min(clip_y1, (int)ceilf(max_y) + 1);
+    if (t.X0 >= t.X1 || t.Y0 >= t.Y1)
+        return false;
+
+    t.Texture = texture;
+    t.U0 = v[0]->uv.x; t.DU1 = v[1]->uv.x - v[0]->uv.x; t.DU2 = v[2]->uv.x - v[0]->uv.x;
+    t.V0 = v[0]->uv.y; t.DV1 = v[1]->uv.y - v[0]->uv.y; t.DV2 = v[2]->uv.y - v[0]->uv.y;
+    for (int c = 0; c < 4; c++)
+    {
+        float c0 = (float)((v[0]->col >> (c * 8)) & 0xFF);
+        t.Col0[c] = c0;
+        t.DCol1[c] = (float)((v[1]->col >> (c * 8)) & 0xFF) - c0;
+        t.DCol2[c] = (float)((v[2]->col >> (c * 8)) & 0xFF) - c0;
+    }
+
+    t.Solid = v[0]->col == v[1]->col && v[0]->col == v[2]->col && t.DU1 == 0.0f && t.DU2 == 0.0f && t.DV1 == 0.0f && t.DV2 == 0.0f;
+    if (t.Solid)
+    {
+        unsigned char texel[4];
+        ImGui_ImplSoftRaster_Sample(texture, t.U0, t.V0, texel);
+        for (int c = 0; c < 4; c++)
+            t.Flat[c] = (unsigned char)ImGui_ImplSoftRaster_Div255(((v[0]->col >> (c * 8)) & 0xFF) * texel[c]);
+        if (t.Flat[3] == 0)
+            return false;
+    }
+    return true;
+}
+
+// Rasterize the part of a triangle inside [x0, x1) x [y0, y1)
+static void ImGui_ImplSoftRaster_DrawTriangle(const ImGui_ImplSoftRaster_Triangle& t, unsigned char* pixels, int stride, int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(x0, t.X0); y0 = std::max(y0, t.Y0);
+    x1 = std::min(x1, t.X1); y1 = std::min(y1, t.Y1);
+
+    for (int y = y0; y < y1; y++)
+    {
+        float py = (float)y + 0.5f;
+
+        // Intersect the three half-planes with this row analytically, then fix float rounding with exact tests at the span ends
+        int xl = x0, xr = x1;
+        bool empty = false;
+        for (int e = 0; e < 3 && !empty; e++)
+        {
+            float row = t.B[e] * py + t.C[e];
+            if (t.A[e] == 0.0f)
+            {
+                empty = !ImGui_ImplSoftRaster_Inside(t, e, row);
+                continue;
+            }
+            float edge_x = std::min(std::max(-row / t.A[e] - 0.5f, (float)x0 - 1.0f), (float)x1 + 1.0f);
+            if (t.A[e] > 0.0f)
+                xl = std::max(xl, (int)ceilf(edge_x));
+            else
+                xr = std::min(xr, (int)floorf(edge_x) + 1);
+        }
+        if (empty)
+            continue;
+        while (xl < xr && !ImGui_ImplSoftRaster_InsideAll(t, xl + 0.5f, py)) xl++;
+        while (xr > xl && !ImGui_ImplSoftRaster_InsideAll(t, xr - 0.5f, py)) xr--;
+        if (xl >= xr)
+            continue;
+        while (xl > x0 && ImGui_ImplSoftRaster_InsideAll(t, xl - 0.5f, py)) xl--;
+        while (xr < x1 && ImGui_ImplSoftRaster_InsideAll(t, xr + 0.5f, py)) xr++;
+
+        unsigned char* row = pixels + (size_t)y * stride;
+        if (t.Solid)
+        {
+            ImGui_ImplSoftRaster_FillSpan(row + xl * 4, xr - xl, t.Flat);
+            continue;
+        }
+
+        for (int x = xl; x < xr; x++)
+        {
+            float px = (float)x + 0.5f;
+            float l1 = (t.A[1] * px + t.B[1] * py + t.C[1]) * t.InvArea;
+            float l2 = (t.A[2] * px + t.B[2] * py + t.C[2]) * t.InvArea;
+            unsigned char texel[4];
+            ImGui_ImplSoftRaster_Sample(t.Texture, t.U0 + t.DU1 * l1 + t.DU2 * l2, t.V0 + t.DV1 * l1 + t.DV2 * l2, texel);
+
+            unsigned int c[4];
+            for (int i = 0; i < 4; i++)
+            {
+                float value = t.Col0[i] + t.DCol1[i] * l1 + t.DCol2[i] * l2;
+                unsigned int vertex = value <= 0.0f ? 0 : value >= 255.0f ? 255 : (unsigned int)(value + 0.5f);
+                c[i] = ImGui_ImplSoftRaster_Div255(vertex * texel[i]);
+            }
+            ImGui_ImplSoftRaster_BlendPixel(row + x * 4, c[0], c[1], c[2], c[3]);
+        }
+    }
+}
+
+void    ImGui_ImplSoftRaster_RenderDrawData(ImDrawData* draw_data, unsigned char* pixels, int width, int height, int stride)
+{
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    ImVec2 offset = draw_data->DisplayPos;
+    ImVec2 scale = draw_data->FramebufferScale;
+    if (scale.x <= 0.0f || scale.y <= 0.0f)
+        scale = ImVec2(1.0f, 1.0f);
+
+    // 1. Set up every visible triangle once
+    g_Triangles.resize(0);
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback != NULL)
+                continue;   // ImDrawCallback_ResetRenderState needs no work, other callbacks target a graphics API
+
+            int clip_x0 = std::max(0, (int)((pcmd->ClipRect.x - offset.x) * scale.x));
+            int clip_y0 = std::max(0, (int)((pcmd->ClipRect.y - offset.y) * scale.y));
+            int clip_x1 = std::min(width, (int)((pcmd->ClipRect.z - offset.x) * scale.x));
+            int clip_y1 = std::min(height, (int)((pcmd->ClipRect.w - offset.y) * scale.y));
+            if (clip_x0 >= clip_x1 || clip_y0 >= clip_y1)
+                continue;
+
+            const ImGui_ImplSoftRaster_Texture* texture = (const ImGui_ImplSoftRaster_Texture*)pcmd->TextureId;
+            const ImDrawVert* vtx = cmd_list->VtxBuffer.Data + pcmd->VtxOffset;
+            const ImDrawIdx* idx = cmd_list->IdxBuffer.Data + pcmd->IdxOffset;
+            for (unsigned int i = 0; i + 2 < pcmd->ElemCount; i += 3)
+            {
+                const ImDrawVert* v[3] = { &vtx[idx[i]], &vtx[idx[i + 1]], &vtx[idx[i + 2]] };
+                ImGui_ImplSoftRaster_Triangle t;
+                if (ImGui_ImplSoftRaster_Setup(t, v, offset, scale, clip_x0, clip_y0, clip_x1, clip_y1, texture))
+                    g_Triangles.push_back(t);
+            }
+        }
+    }
+
+    // 2. Bin triangles into tiles: count, prefix sum, fill (keeps submission order inside each tile)
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int tile_count = tiles_x * tiles_y;
+    g_BinOffsets.assign(tile_count + 1, 0);
+    for (size_t i = 0; i < g_Triangles.size(); i++)
+    {
+        const ImGui_ImplSoftRaster_Triangle& t = g_Triangles[i];
+        for (int ty = t.Y0 / TILE_SIZE; ty <= (t.Y1 - 1) / TILE_SIZE; ty++)
+            for (int tx = t.X0 / TILE_SIZE; tx <= (t.X1 - 1) / TILE_SIZE; tx++)
+                g_BinOffsets[ty * tiles_x + tx + 1]++;
+    }
+    for (int i = 0; i < tile_count; i++)
+        g_BinOffsets[i + 1] += g_BinOffsets[i];
+    g_BinTriangles.resize(g_BinOffsets[tile_count]);
+    std::vector<int> fill(g_BinOffsets.begin(), g_BinOffsets.end() - 1);
+    for (size_t i = 0; i < g_Triangles.size(); i++)
+    {
+        const ImGui_ImplSoftRaster_Triangle& t = g_Triangles[i];
+        for (int ty = t.Y0 / TILE_SIZE; ty <= (t.Y1 - 1) / TILE_SIZE; ty++)
+            for (int tx = t.X0 / TILE_SIZE; tx <= (t.X1 - 1) / TILE_SIZE; tx++)
+                g_BinTriangles[fill[ty * tiles_x + tx]++] = (int)i;
+    }
+
+    // 3. Rasterize tiles on the calling thread and the pool
+    ImGui_ImplSoftRaster_Frame frame;
+    frame.Pixels = pixels;
+    frame.Width = width;
+    frame.Height = height;
+    frame.Stride = stride;
+    frame.TilesX = tiles_x;
+    frame.TileCount = tile_count;
+    frame.NextTile = 0;
+
+    // Waking the workers is not free, small frames are cheaper on the calling thread alone
+    bool parallel = !g_PoolThreads.empty() && tile_count > 1 && g_BinTriangles.size() >= 2048;
+    if (parallel)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_PoolMutex);
+            g_PoolFrame = &frame;
+            g_PoolBusy = (int)g_PoolThreads.size();
+            g_PoolGeneration++;
+        }
+        g_PoolWake.notify_all();
+    }
+    ImGui_ImplSoftRaster_DrawTiles(frame);
+    if (parallel)
+    {
+        // Every worker must have seen this frame before the next one can start
+        std::unique_lock<std::mutex> lock(g_PoolMutex);
+        g_PoolIdle.wait(lock, []() { return g_PoolBusy == 0; });
+        g_PoolFrame = NULL;
+    }
+
+    g_LastFrameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
@@ -0,0 +1,51 @@
+// dear imgui: Renderer for a CPU software rasterizer
+// Renders ImDrawData into a caller-owned RGBA8 buffer without any graphics API.
+// Useful for headless screenshot tests, where no window or OpenGL context exists.
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..) or none at all for headless use.
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'ImGui_ImplSoftRaster_Texture*' as void*/ImTextureID. Read the FAQ about ImTextureID!
+//  [X] Renderer: Support for large meshes (64k+ vertices) with 16-bit indices.
+//  [X] Renderer: Scissor rectangles, alpha blending (SRC_ALPHA, ONE_MINUS_SRC_ALPHA), nearest texture sampling.
+//  [X] Renderer: Tile-parallel rasterization on worker threads, SSE2 span filling for solid-color triangles.
+// Missing features:
+//  [ ] Renderer: User callbacks are skipped (they usually issue graphics API calls), except ImDrawCallback_ResetRenderState which needs no work.
+
+// You can copy and use unmodified imgui_impl_* files in your project. See example_glfw_opengl3/softraster_shot.cpp for an example of using this.
+// If you are new to dear imgui, read examples/README.txt and read the documentation at the top of imgui.cpp.
+// https://github.com/ocornut/imgui
+
+// Usage:
+//  ImGui_ImplSoftRaster_Init(0);                 // 0 = one thread per core, starts the worker threads
+//  ...each frame:
+//  ImGui_ImplSoftRaster_NewFrame();
+//  ImGui::NewFrame(); ... ImGui::Render();
+//  ImGui_ImplSoftRaster_RenderDrawData(ImGui::GetDrawData(), pixels, width, height, width * 4);
+//  ...at exit:
+//  ImGui_ImplSoftRaster_Shutdown();              // joins the worker threads
+// The buffer is not cleared; fill it with the background color first.
+// Pixels are 4 bytes in R,G,B,A memory order, the same layout as ImGui font atlas RGBA32 data.
+
+#pragma once
+
+// Texture for ImTextureID: RGBA8 pixels in R,G,B,A memory order, owned by the caller.
+struct ImGui_ImplSoftRaster_Texture
+{
+    const unsigned char*    Pixels;
+    int                     Width;
+    int                     Height;
+    int                     Stride;     // Bytes per row
+};
+
+// Backend API
+IMGUI_IMPL_API bool     ImGui_ImplSoftRaster_Init(int threads = 0);
+IMGUI_IMPL_API void     ImGui_ImplSoftRaster_Shutdown();
+IMGUI_IMPL_API void     ImGui_ImplSoftRaster_NewFrame();
+IMGUI_IMPL_API void     ImGui_ImplSoftRaster_RenderDrawData(ImDrawData* draw_data, unsigned char* pixels, int width, int height, int stride);
+
+// Cost of the last ImGui_ImplSoftRaster_RenderDrawData() call in milliseconds
+IMGUI_IMPL_API double   ImGui_ImplSoftRaster_GetLastFrameTime();
+
+// (Optional) Called by Init/NewFrame/Shutdown
+IMGUI_IMPL_API bool     ImGui_ImplSoftRaster_CreateFontsTexture();
+IMGUI_IMPL_API void     ImGui_ImplSoftRaster_DestroyFontsTexture();